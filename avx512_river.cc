@@ -0,0 +1,316 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// AVX-512 River kernels. AVX512RiverCopy/Xor hold one state in fewer
+// registers but are no faster than the AVX-2 kernels: the Update dependency
+// chain, not the number of instructions, limits throughput. The *2 kernels
+// advance two independent states, one per 256-bit half, which hides that
+// latency.
+
+#include "dispatch.h"
+
+#include "vec512.h"
+
+namespace {
+
+// Same algorithm as RiverImpl in river.cc. The state layout is also the
+// same: 64 words of packets, then v0..v3 and mul0..mul3.
+const int kPacketWords = 64;
+const int kVectorsPerPacket = kPacketWords / 8;
+
+// Swaps the 128-bit quarters and 32-bit halves within each 256-bit half,
+// i.e. RiverImpl::Permute of both halves.
+INLINE V8x64U Permute(const V8x64U& val) {
+  const V8x64U indices(0x0000000a0000000bull, 0x0000000800000009ull,
+                       0x0000000e0000000full, 0x0000000c0000000dull,
+                       0x0000000200000003ull, 0x0000000000000001ull,
+                       0x0000000600000007ull, 0x0000000400000005ull);
+  return V8x64U(_mm512_permutexvar_epi32(indices, val));
+}
+
+// See RiverImpl::ZipperMerge.
+INLINE V8x64U ZipperMerge(const V8x64U& v) {
+  const uint64_t hi = 0x070806090D0A040Bull;
+  const uint64_t lo = 0x000F010E05020C03ull;
+  return V8x64U(
+      _mm512_shuffle_epi8(v, V8x64U(hi, lo, hi, lo, hi, lo, hi, lo)));
+}
+
+INLINE V8x64U Mul32(const V8x64U& a, const V8x64U& b) {
+  return V8x64U(_mm512_mul_epu32(a, b));
+}
+
+// Returns the lower half of "low" and upper half of "high".
+INLINE V8x64U Blend(const V8x64U& low, const V8x64U& high) {
+  return V8x64U(_mm512_mask_blend_epi64(0xF0, low, high));
+}
+
+// One River instance whose eight 256-bit registers are paired into four
+// 512-bit registers: v01 holds v0 in the lower and v1 in the upper half,
+// likewise v23, mul01 and mul23. Each packet is held in eight registers
+// (one per pair of RiverImpl's 256-bit packet vectors), so it is only
+// loaded and stored at the start and end of a run of packets.
+class RiverState512 {
+ public:
+  explicit INLINE RiverState512(uint64_t* RESTRICT state) : state_(state) {
+    for (int i = 0; i < kVectorsPerPacket; ++i) {
+      packet_[i] = LoadU(state + i * 8);
+    }
+    v01_ = LoadU(state + kPacketWords + 0);
+    v23_ = LoadU(state + kPacketWords + 8);
+    mul01_ = LoadU(state + kPacketWords + 16);
+    mul23_ = LoadU(state + kPacketWords + 24);
+  }
+
+  INLINE ~RiverState512() {
+    for (int i = 0; i < kVectorsPerPacket; ++i) {
+      StoreU(packet_[i], state_ + i * 8);
+    }
+    StoreU(v01_, state_ + kPacketWords + 0);
+    StoreU(v23_, state_ + kPacketWords + 8);
+    StoreU(mul01_, state_ + kPacketWords + 16);
+    StoreU(mul23_, state_ + kPacketWords + 24);
+  }
+
+  // Equivalent to RiverImpl::Update(out1, out2) for out12 = (out1, out2).
+  // RiverImpl updates v1 and v0 with the previous mul0 and mul1; this
+  // combines the halves of v01 before and after that update so that each
+  // multiplication sees the same inputs as in RiverImpl.
+  INLINE void Update(V8x64U* RESTRICT out12) {
+    v01_ += *out12;
+    const V8x64U v01 = v01_ ^ SwapHalves(mul01_);
+    mul01_ ^= Mul32(Blend(v01_, v01), Permute(v23_));
+    v01_ = v01;
+    const V8x64U v23 = v23_ ^ SwapHalves(mul23_);
+    mul23_ ^= Mul32(Permute(v01_), Blend(v23_, v23));
+    v23_ = v23;
+    v01_ ^= ZipperMerge(v23_);
+    v23_ += ZipperMerge(v01_);
+    *out12 += v23_;
+  }
+
+  // Generates the next packet and passes each 64-byte vector and its index
+  // to "output". Unrolled so that packet_ is indexed by constants.
+  template <class Output>
+  INLINE void UpdatePacket(const Output& output) {
+    UpdateVector<0>(output);
+    UpdateVector<1>(output);
+    UpdateVector<2>(output);
+    UpdateVector<3>(output);
+    UpdateVector<4>(output);
+    UpdateVector<5>(output);
+    UpdateVector<6>(output);
+    UpdateVector<7>(output);
+  }
+
+  template <int i, class Output>
+  INLINE void UpdateVector(const Output& output) {
+    Update(&packet_[i]);
+    output(packet_[i], i);
+  }
+
+ private:
+  uint64_t* state_;
+  V8x64U packet_[kVectorsPerPacket];
+  V8x64U v01_;
+  V8x64U v23_;
+  V8x64U mul01_;
+  V8x64U mul23_;
+};
+
+// Two independent River instances, one per 256-bit half of each register:
+// the AVX-2 algorithm with twice as many lanes.
+class RiverStatePair512 {
+ public:
+  INLINE RiverStatePair512(uint64_t* RESTRICT state0,
+                           uint64_t* RESTRICT state1)
+      : state0_(state0), state1_(state1) {
+    for (int i = 0; i < 2 * kVectorsPerPacket; ++i) {
+      packet_[i] = Load2(i * 4);
+    }
+    v0_ = Load2(kPacketWords + 0);
+    v1_ = Load2(kPacketWords + 4);
+    v2_ = Load2(kPacketWords + 8);
+    v3_ = Load2(kPacketWords + 12);
+    mul0_ = Load2(kPacketWords + 16);
+    mul1_ = Load2(kPacketWords + 20);
+    mul2_ = Load2(kPacketWords + 24);
+    mul3_ = Load2(kPacketWords + 28);
+  }
+
+  INLINE ~RiverStatePair512() {
+    for (int i = 0; i < 2 * kVectorsPerPacket; ++i) {
+      Store2(packet_[i], i * 4);
+    }
+    Store2(v0_, kPacketWords + 0);
+    Store2(v1_, kPacketWords + 4);
+    Store2(v2_, kPacketWords + 8);
+    Store2(v3_, kPacketWords + 12);
+    Store2(mul0_, kPacketWords + 16);
+    Store2(mul1_, kPacketWords + 20);
+    Store2(mul2_, kPacketWords + 24);
+    Store2(mul3_, kPacketWords + 28);
+  }
+
+  // Same as RiverImpl::Update.
+  INLINE void Update(V8x64U* RESTRICT out1, V8x64U* RESTRICT out2) {
+    v0_ += *out1;
+    v1_ += *out2;
+    v1_ ^= mul0_;
+    mul0_ ^= Mul32(v0_, Permute(v2_));
+    v0_ ^= mul1_;
+    mul1_ ^= Mul32(v1_, Permute(v3_));
+    v3_ ^= mul2_;
+    mul2_ ^= Mul32(Permute(v0_), v2_);
+    v2_ ^= mul3_;
+    mul3_ ^= Mul32(Permute(v1_), v3_);
+    v0_ ^= ZipperMerge(v2_);
+    v1_ ^= ZipperMerge(v3_);
+    v2_ += ZipperMerge(v0_);
+    v3_ += ZipperMerge(v1_);
+    *out1 += v2_;
+    *out2 += v3_;
+  }
+
+  // Generates the next packet of both instances and passes each vector
+  // (the i-th 32-byte output of both) to "output".
+  template <class Output>
+  INLINE void UpdatePacket(const Output& output) {
+    UpdateVectors<0>(output);
+    UpdateVectors<2>(output);
+    UpdateVectors<4>(output);
+    UpdateVectors<6>(output);
+    UpdateVectors<8>(output);
+    UpdateVectors<10>(output);
+    UpdateVectors<12>(output);
+    UpdateVectors<14>(output);
+  }
+
+ private:
+  template <int i, class Output>
+  INLINE void UpdateVectors(const Output& output) {
+    Update(&packet_[i], &packet_[i + 1]);
+    output(packet_[i], i);
+    output(packet_[i + 1], i + 1);
+  }
+
+  INLINE V8x64U Load2(const int offset) const {
+    const __m256i lower = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(state0_ + offset));
+    const __m256i upper = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(state1_ + offset));
+    return V8x64U(_mm512_inserti64x4(_mm512_castsi256_si512(lower), upper, 1));
+  }
+
+  INLINE void Store2(const V8x64U& v, const int offset) const {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state0_ + offset),
+                        _mm512_castsi512_si256(v));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state1_ + offset),
+                        _mm512_extracti64x4_epi64(v, 1));
+  }
+
+  uint64_t* state0_;
+  uint64_t* state1_;
+  V8x64U packet_[2 * kVectorsPerPacket];
+  V8x64U v0_;
+  V8x64U v1_;
+  V8x64U v2_;
+  V8x64U v3_;
+  V8x64U mul0_;
+  V8x64U mul1_;
+  V8x64U mul2_;
+  V8x64U mul3_;
+};
+
+}  // namespace
+
+void AVX512RiverCopy(uint64_t* state, const uint64_t num_packets,
+                     uint8_t* bytes, const bool stream) {
+  RiverState512 river(state);
+  uint64_t* to = reinterpret_cast<uint64_t*>(bytes);
+  if (stream && reinterpret_cast<uintptr_t>(bytes) % sizeof(V8x64U) == 0) {
+    for (uint64_t p = 0; p < num_packets; ++p, to += kPacketWords) {
+      river.UpdatePacket(
+          [to](const V8x64U& v, const int i) { Stream(v, to + i * 8); });
+    }
+    _mm_sfence();
+  } else {
+    for (uint64_t p = 0; p < num_packets; ++p, to += kPacketWords) {
+      river.UpdatePacket(
+          [to](const V8x64U& v, const int i) { StoreU(v, to + i * 8); });
+    }
+  }
+}
+
+void AVX512RiverXor(uint64_t* state, const uint64_t num_packets,
+                    uint8_t* bytes) {
+  RiverState512 river(state);
+  uint64_t* to = reinterpret_cast<uint64_t*>(bytes);
+  for (uint64_t p = 0; p < num_packets; ++p, to += kPacketWords) {
+    river.UpdatePacket([to](const V8x64U& v, const int i) {
+      StoreU(LoadU(to + i * 8) ^ v, to + i * 8);
+    });
+  }
+}
+
+void AVX512RiverCopy2(uint64_t* state0, uint64_t* state1,
+                      const uint64_t num_packets, uint8_t* bytes0,
+                      uint8_t* bytes1, const bool stream) {
+  RiverStatePair512 river(state0, state1);
+  __m256i* to0 = reinterpret_cast<__m256i*>(bytes0);
+  __m256i* to1 = reinterpret_cast<__m256i*>(bytes1);
+  const int kPacketVectors = 2 * kVectorsPerPacket;
+  if (stream && (reinterpret_cast<uintptr_t>(bytes0) |
+                 reinterpret_cast<uintptr_t>(bytes1)) % 32 == 0) {
+    for (uint64_t p = 0; p < num_packets; ++p) {
+      river.UpdatePacket([to0, to1](const V8x64U& v, const int i) {
+        _mm256_stream_si256(to0 + i, _mm512_castsi512_si256(v));
+        _mm256_stream_si256(to1 + i, _mm512_extracti64x4_epi64(v, 1));
+      });
+      to0 += kPacketVectors;
+      to1 += kPacketVectors;
+    }
+    _mm_sfence();
+  } else {
+    for (uint64_t p = 0; p < num_packets; ++p) {
+      river.UpdatePacket([to0, to1](const V8x64U& v, const int i) {
+        _mm256_storeu_si256(to0 + i, _mm512_castsi512_si256(v));
+        _mm256_storeu_si256(to1 + i, _mm512_extracti64x4_epi64(v, 1));
+      });
+      to0 += kPacketVectors;
+      to1 += kPacketVectors;
+    }
+  }
+}
+
+void AVX512RiverXor2(uint64_t* state0, uint64_t* state1,
+                     const uint64_t num_packets, uint8_t* bytes0,
+                     uint8_t* bytes1) {
+  RiverStatePair512 river(state0, state1);
+  __m256i* to0 = reinterpret_cast<__m256i*>(bytes0);
+  __m256i* to1 = reinterpret_cast<__m256i*>(bytes1);
+  const int kPacketVectors = 2 * kVectorsPerPacket;
+  for (uint64_t p = 0; p < num_packets; ++p) {
+    river.UpdatePacket([to0, to1](const V8x64U& v, const int i) {
+      const __m256i lower = _mm512_castsi512_si256(v);
+      const __m256i upper = _mm512_extracti64x4_epi64(v, 1);
+      _mm256_storeu_si256(
+          to0 + i, _mm256_xor_si256(_mm256_loadu_si256(to0 + i), lower));
+      _mm256_storeu_si256(
+          to1 + i, _mm256_xor_si256(_mm256_loadu_si256(to1 + i), upper));
+    });
+    to0 += kPacketVectors;
+    to1 += kPacketVectors;
+  }
+}
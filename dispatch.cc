@@ -0,0 +1,233 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Public entry points: each forwards to the fastest implementation the CPU
+// supports. This file is compiled without any instruction-set flags so that
+// it runs on every x86-64 CPU.
+
+#include "dispatch.h"
+
+#include <cstring>  // memcpy
+#include "highway_tree_hash.h"
+#include "highway_tree_hash512.h"
+#include "instruction_sets.h"
+#include "river.h"
+#include "scalar_highway_tree_hash.h"
+#include "scalar_highway_tree_hash512.h"
+#include "scalar_sip_hash.h"
+#include "scalar_sip_tree_hash.h"
+#include "sip_hash.h"
+#include "sip_hash_batch.h"
+#include "sip_tree_hash.h"
+
+namespace {
+
+const int kPacketSize = 32;
+const int kPacketSize512 = 512;
+
+// Function pointers for one instruction set. Chosen once, so each call only
+// costs an indirect (and well-predicted) branch.
+struct DispatchTable {
+  uint64_t (*highway_tree_hash)(const uint64_t (&)[4], const uint8_t*,
+                                const uint64_t);
+  void (*highway_tree_hash_batch)(const uint64_t (&)[4],
+                                  const uint8_t* const*, const uint64_t*,
+                                  const uint64_t, uint64_t*);
+  void (*highway_tree_hash_reset)(const uint64_t (&)[4], uint64_t*);
+  void (*highway_tree_hash_update)(const uint8_t*, const uint64_t, uint64_t*);
+  uint64_t (*highway_tree_hash_finalize)(const uint64_t*, const uint8_t*,
+                                         const uint64_t);
+
+  void (*highway_tree_hash512)(const uint64_t (&)[8], const uint8_t*,
+                               const uint64_t, uint64_t*);
+  void (*highway_tree_hash512_reset)(const uint64_t (&)[8], uint64_t*);
+  void (*highway_tree_hash512_update)(const uint8_t*, const uint64_t,
+                                      uint64_t*);
+  void (*highway_tree_hash512_finalize)(const uint64_t*, const uint8_t*,
+                                        const uint64_t, uint64_t*);
+
+  uint64_t (*sip_hash)(const uint64_t*, const uint8_t*, const uint64_t);
+  uint64_t (*reduce_sip_tree_hash)(const uint64_t*, const uint64_t*);
+  uint64_t (*sip_tree_hash)(const uint64_t (&)[4], const uint8_t*,
+                            const uint64_t);
+  void (*sip_hash_batch)(const uint64_t*, const uint8_t* const*,
+                         const uint64_t*, uint64_t*);
+};
+
+const DispatchTable kAVX2Table = {
+    AVX2HighwayTreeHash,         AVX2HighwayTreeHashBatch,
+    AVX2HighwayTreeHashReset,    AVX2HighwayTreeHashUpdate,
+    AVX2HighwayTreeHashFinalize, AVX2HighwayTreeHash512,
+    AVX2HighwayTreeHash512Reset, AVX2HighwayTreeHash512Update,
+    AVX2HighwayTreeHash512Finalize,
+    AVX2SipHash,                 AVX2ReduceSipTreeHash,
+    AVX2SipTreeHash,             AVX2SipHashBatch};
+
+// SSE4.1 only speeds up HighwayTreeHash; the others are portable.
+const DispatchTable kSSE41Table = {
+    SSE41HighwayTreeHash,          SSE41HighwayTreeHashBatch,
+    SSE41HighwayTreeHashReset,     SSE41HighwayTreeHashUpdate,
+    SSE41HighwayTreeHashFinalize,  ScalarHighwayTreeHash512,
+    ScalarHighwayTreeHash512Reset, ScalarHighwayTreeHash512Update,
+    ScalarHighwayTreeHash512Finalize,
+    ScalarSipHash,                 ScalarReduceSipTreeHash,
+    ScalarSipTreeHash,             ScalarSipHashBatch};
+
+const DispatchTable kScalarTable = {
+    ScalarHighwayTreeHash,         ScalarHighwayTreeHashBatch,
+    ScalarHighwayTreeHashReset,    ScalarHighwayTreeHashUpdate,
+    ScalarHighwayTreeHashFinalize, ScalarHighwayTreeHash512,
+    ScalarHighwayTreeHash512Reset, ScalarHighwayTreeHash512Update,
+    ScalarHighwayTreeHash512Finalize,
+    ScalarSipHash,                 ScalarReduceSipTreeHash,
+    ScalarSipTreeHash,             ScalarSipHashBatch};
+
+const DispatchTable* ChooseTable() {
+  const uint32_t supported = InstructionSets::Supported();
+  if (supported & InstructionSets::kAVX2) {
+    return &kAVX2Table;
+  }
+  if (supported & InstructionSets::kSSE41) {
+    return &kSSE41Table;
+  }
+  return &kScalarTable;
+}
+
+// Thread-safe: C++11 guarantees one-time initialization of the static.
+INLINE const DispatchTable& Table() {
+  static const DispatchTable* const table = ChooseTable();
+  return *table;
+}
+
+}  // namespace
+
+uint64_t HighwayTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
+                         const uint64_t size) {
+  return Table().highway_tree_hash(key, bytes, size);
+}
+
+void HighwayTreeHashBatch(const uint64_t (&key)[4], const uint8_t* const* bytes,
+                          const uint64_t* sizes, const uint64_t num,
+                          uint64_t* hashes) {
+  Table().highway_tree_hash_batch(key, bytes, sizes, num, hashes);
+}
+
+void HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                        const uint64_t size, uint64_t out[8]) {
+  Table().highway_tree_hash512(key, bytes, size, out);
+}
+
+uint64_t SipHash(const uint64_t key[2], const uint8_t* bytes,
+                 const uint64_t size) {
+  return Table().sip_hash(key, bytes, size);
+}
+
+uint64_t ReduceSipTreeHash(const uint64_t key[2], const uint64_t hashes[4]) {
+  return Table().reduce_sip_tree_hash(key, hashes);
+}
+
+uint64_t SipTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
+                     const uint64_t size) {
+  return Table().sip_tree_hash(key, bytes, size);
+}
+
+void SipHashBatch(const uint64_t key[2], const uint8_t* const bytes[4],
+                  const uint64_t sizes[4], uint64_t hashes[4]) {
+  Table().sip_hash_batch(key, bytes, sizes, hashes);
+}
+
+// Defined here because river.cc is compiled for AVX-2.
+bool River::Supported() {
+  return InstructionSets::Supported() & InstructionSets::kAVX2;
+}
+
+void HighwayTreeHashStream::Reset(const uint64_t (&key)[4]) {
+  Table().highway_tree_hash_reset(key, state_);
+  size_ = 0;
+}
+
+void HighwayTreeHashStream::Update(const uint8_t* bytes, const uint64_t size) {
+  const size_t buffered = size_ & (kPacketSize - 1);
+  size_ += size;
+
+  // Not enough for a whole packet: only append to the buffer.
+  if (buffered + size < kPacketSize) {
+    memcpy(buffer_ + buffered, bytes, size);
+    return;
+  }
+
+  const DispatchTable& table = Table();
+  uint64_t remaining = size;
+  if (buffered != 0) {
+    const size_t missing = kPacketSize - buffered;
+    memcpy(buffer_ + buffered, bytes, missing);
+    table.highway_tree_hash_update(buffer_, 1, state_);
+    bytes += missing;
+    remaining -= missing;
+  }
+
+  const size_t remainder = remaining & (kPacketSize - 1);
+  const size_t truncated_size = remaining - remainder;
+  if (truncated_size != 0) {
+    table.highway_tree_hash_update(bytes, truncated_size / kPacketSize,
+                                   state_);
+  }
+
+  memcpy(buffer_, bytes + truncated_size, remainder);
+}
+
+uint64_t HighwayTreeHashStream::Finalize() const {
+  return Table().highway_tree_hash_finalize(state_, buffer_, size_);
+}
+
+void HighwayTreeHashStream512::Reset(const uint64_t (&key)[8]) {
+  Table().highway_tree_hash512_reset(key, state_);
+  buffered_ = 0;
+}
+
+void HighwayTreeHashStream512::Update(const uint8_t* bytes,
+                                      const uint64_t size) {
+  // Not more than a packet: only append to the buffer.
+  if (buffered_ + size <= kPacketSize512) {
+    memcpy(buffer_ + buffered_, bytes, size);
+    buffered_ += size;
+    return;
+  }
+
+  const DispatchTable& table = Table();
+
+  // The buffered packet is no longer the last one.
+  uint64_t remaining = size;
+  if (buffered_ != 0) {
+    const size_t missing = kPacketSize512 - buffered_;
+    memcpy(buffer_ + buffered_, bytes, missing);
+    table.highway_tree_hash512_update(buffer_, 1, state_);
+    bytes += missing;
+    remaining -= missing;
+  }
+
+  // Hash all packets except the final one, which is held back.
+  const uint64_t num_packets = (remaining - 1) / kPacketSize512;
+  if (num_packets != 0) {
+    table.highway_tree_hash512_update(bytes, num_packets, state_);
+    bytes += num_packets * kPacketSize512;
+    remaining -= num_packets * kPacketSize512;
+  }
+
+  memcpy(buffer_, bytes, remaining);
+  buffered_ = remaining;
+}
+
+void HighwayTreeHashStream512::Finalize(uint64_t out[8]) const {
+  Table().highway_tree_hash512_finalize(state_, buffer_, buffered_, out);
+}
@@ -0,0 +1,153 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_DISPATCH_H_
+#define HIGHWAYHASH_DISPATCH_H_
+
+// Implementations of the public functions for specific instruction sets.
+// Each source file is compiled with only the instruction set it requires
+// (see Makefile). dispatch.cc defines the public functions, which call the
+// fastest of these that the CPU supports. Applications should call the
+// public functions; these declarations are for dispatch.cc and benchmarks.
+//
+// Implementations of the same function return identical results. The
+// "state" of HighwayTreeHash* consists of 16 uint64_t in the same layout
+// for all implementations, so that streams can be resumed by any of them.
+
+#include <cstdint>
+
+// highway_tree_hash.cc (AVX-2)
+
+uint64_t AVX2HighwayTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
+                             const uint64_t size);
+
+void AVX2HighwayTreeHashBatch(const uint64_t (&key)[4],
+                              const uint8_t* const* bytes,
+                              const uint64_t* sizes, const uint64_t num,
+                              uint64_t* hashes);
+
+// Building blocks of HighwayTreeHashStream: initializes "state", updates it
+// with "num_packets" whole 32-byte packets, and returns the hash after the
+// final packet, which consists of the last (size % 32) bytes.
+void AVX2HighwayTreeHashReset(const uint64_t (&key)[4], uint64_t* state);
+void AVX2HighwayTreeHashUpdate(const uint8_t* packets,
+                               const uint64_t num_packets, uint64_t* state);
+uint64_t AVX2HighwayTreeHashFinalize(const uint64_t* state,
+                                     const uint8_t* final_bytes,
+                                     const uint64_t size);
+
+// sse41_highway_tree_hash.cc (SSE4.1)
+
+uint64_t SSE41HighwayTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
+                              const uint64_t size);
+
+void SSE41HighwayTreeHashBatch(const uint64_t (&key)[4],
+                               const uint8_t* const* bytes,
+                               const uint64_t* sizes, const uint64_t num,
+                               uint64_t* hashes);
+
+void SSE41HighwayTreeHashReset(const uint64_t (&key)[4], uint64_t* state);
+void SSE41HighwayTreeHashUpdate(const uint8_t* packets,
+                                const uint64_t num_packets, uint64_t* state);
+uint64_t SSE41HighwayTreeHashFinalize(const uint64_t* state,
+                                      const uint8_t* final_bytes,
+                                      const uint64_t size);
+
+// scalar_highway_tree_hash.cc (ScalarHighwayTreeHash is declared in
+// scalar_highway_tree_hash.h)
+
+void ScalarHighwayTreeHashBatch(const uint64_t (&key)[4],
+                                const uint8_t* const* bytes,
+                                const uint64_t* sizes, const uint64_t num,
+                                uint64_t* hashes);
+
+void ScalarHighwayTreeHashReset(const uint64_t (&key)[4], uint64_t* state);
+void ScalarHighwayTreeHashUpdate(const uint8_t* packets,
+                                 const uint64_t num_packets, uint64_t* state);
+uint64_t ScalarHighwayTreeHashFinalize(const uint64_t* state,
+                                       const uint8_t* final_bytes,
+                                       const uint64_t size);
+
+// highway_tree_hash512.cc (AVX-2)
+
+void AVX2HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                            const uint64_t size, uint64_t out[8]);
+
+// Building blocks of HighwayTreeHashStream512: initializes "state", updates
+// it with "num_packets" whole 512-byte packets (never the final packet), and
+// stores the hash after the final packet of "remainder" (0..512) bytes.
+void AVX2HighwayTreeHash512Reset(const uint64_t (&key)[8], uint64_t* state);
+void AVX2HighwayTreeHash512Update(const uint8_t* packets,
+                                  const uint64_t num_packets,
+                                  uint64_t* state);
+void AVX2HighwayTreeHash512Finalize(const uint64_t* state,
+                                    const uint8_t* final_bytes,
+                                    const uint64_t remainder, uint64_t out[8]);
+
+// scalar_highway_tree_hash512.cc (ScalarHighwayTreeHash512 is declared in
+// scalar_highway_tree_hash512.h)
+
+void ScalarHighwayTreeHash512Reset(const uint64_t (&key)[8], uint64_t* state);
+void ScalarHighwayTreeHash512Update(const uint8_t* packets,
+                                    const uint64_t num_packets,
+                                    uint64_t* state);
+void ScalarHighwayTreeHash512Finalize(const uint64_t* state,
+                                      const uint8_t* final_bytes,
+                                      const uint64_t remainder,
+                                      uint64_t out[8]);
+
+// river.cc (AVX-2)
+
+// Advance the River "state" (River::kStateWords words) by "num_packets"
+// 512-byte packets. *Copy stores them to "bytes", with non-temporal stores
+// if "stream" and "bytes" is vector-aligned; *Xor XORs them into "bytes".
+void AVX2RiverCopy(uint64_t* state, const uint64_t num_packets,
+                   uint8_t* bytes, const bool stream);
+void AVX2RiverXor(uint64_t* state, const uint64_t num_packets,
+                  uint8_t* bytes);
+
+// avx512_river.cc (AVX-512F and AVX-512BW)
+
+void AVX512RiverCopy(uint64_t* state, const uint64_t num_packets,
+                     uint8_t* bytes, const bool stream);
+void AVX512RiverXor(uint64_t* state, const uint64_t num_packets,
+                    uint8_t* bytes);
+
+// Advance two independent River states at once (one per 256-bit half of
+// each register); the packets of "state0" go to "bytes0", likewise for 1.
+void AVX512RiverCopy2(uint64_t* state0, uint64_t* state1,
+                      const uint64_t num_packets, uint8_t* bytes0,
+                      uint8_t* bytes1, const bool stream);
+void AVX512RiverXor2(uint64_t* state0, uint64_t* state1,
+                     const uint64_t num_packets, uint8_t* bytes0,
+                     uint8_t* bytes1);
+
+// sip_hash.cc, sip_tree_hash.cc, sip_hash_batch.cc (AVX-2)
+
+uint64_t AVX2SipHash(const uint64_t key[2], const uint8_t* bytes,
+                     const uint64_t size);
+uint64_t AVX2ReduceSipTreeHash(const uint64_t key[2],
+                               const uint64_t hashes[4]);
+uint64_t AVX2SipTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
+                         const uint64_t size);
+void AVX2SipHashBatch(const uint64_t key[2], const uint8_t* const bytes[4],
+                      const uint64_t sizes[4], uint64_t hashes[4]);
+
+// scalar_sip_hash.cc (ScalarSipHash and ScalarReduceSipTreeHash are declared
+// in scalar_sip_hash.h; ScalarSipTreeHash in scalar_sip_tree_hash.h)
+
+void ScalarSipHashBatch(const uint64_t key[2], const uint8_t* const bytes[4],
+                        const uint64_t sizes[4], uint64_t hashes[4]);
+
+#endif  // #ifndef HIGHWAYHASH_DISPATCH_H_
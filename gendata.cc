@@ -10,6 +10,10 @@ int main(int argc, char* argv[]) {
   ALIGNED(uint64_t, 64) key[8] = {1,};
   ALIGNED(uint8_t, 64) in[512] = {0,};
   uint64_t inval = 0;
+  if (!River::Supported()) {
+    fprintf(stderr, "gendata: River requires a CPU with AVX-2\n");
+    return 1;
+  }
   River river(key);
   while (true) {
     memcpy(in, &inval, sizeof(uint32_t));
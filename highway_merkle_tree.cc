@@ -0,0 +1,201 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "highway_merkle_tree.h"
+
+#include <algorithm>
+#include <cstring>  // memcpy
+#include "highway_tree_hash512.h"
+
+namespace {
+
+const int kDigestWords = HighwayMerkleTree::kDigestWords;
+const int kDigestSize = kDigestWords * sizeof(uint64_t);
+
+// Derived keys for interior nodes and the root. HighwayTreeHash512 only uses
+// the first 256 bits of the key.
+enum KeyType { kNodeKey = 1, kRootKey = 2 };
+
+void DeriveKey(const uint64_t (&key)[8], const KeyType type,
+               uint64_t (&derived)[8]) {
+  for (int i = 0; i < 8; ++i) {
+    derived[i] = key[i] ^ (0x9E3779B97F4A7C15ULL * type);
+  }
+}
+
+// Stores the (truncated) digest of "size" bytes.
+void Digest(const uint64_t (&key)[8], const uint8_t* bytes,
+            const uint64_t size, uint64_t* digest) {
+  uint64_t hash[8];
+  HighwayTreeHash512(key, bytes, size, hash);
+  memcpy(digest, hash, kDigestSize);
+}
+
+// Stores the digest of the parent of "left" and "right" (may be null).
+void NodeDigest(const uint64_t (&node_key)[8], const uint64_t* left,
+                const uint64_t* right, uint64_t* digest) {
+  if (right == nullptr) {
+    memcpy(digest, left, kDigestSize);
+    return;
+  }
+  uint64_t children[2 * kDigestWords];
+  memcpy(children, left, kDigestSize);
+  memcpy(children + kDigestWords, right, kDigestSize);
+  Digest(node_key, reinterpret_cast<const uint8_t*>(children),
+         sizeof(children), digest);
+}
+
+void RootDigest(const uint64_t (&root_key)[8], const uint64_t* top,
+                const uint64_t size, uint64_t* root) {
+  uint64_t input[kDigestWords + 1];
+  memcpy(input, top, kDigestSize);
+  input[kDigestWords] = size;
+  Digest(root_key, reinterpret_cast<const uint8_t*>(input), sizeof(input),
+         root);
+}
+
+uint64_t ValidChunkSize(const uint64_t chunk_size) {
+  if (chunk_size == 0) return HighwayMerkleTree::kDefaultChunkSize;
+  return chunk_size;
+}
+
+uint64_t NumChunks(const uint64_t size, const uint64_t chunk_size) {
+  return std::max<uint64_t>(1, (size + chunk_size - 1) / chunk_size);
+}
+
+}  // namespace
+
+HighwayMerkleTree::HighwayMerkleTree(const uint64_t (&key)[8],
+                                     const uint8_t* bytes, const uint64_t size,
+                                     const uint64_t chunk_size)
+    : size_(size), chunk_size_(ValidChunkSize(chunk_size)) {
+  memcpy(key_, key, sizeof(key_));
+
+  uint64_t num_nodes = ::NumChunks(size, chunk_size_);
+  for (;;) {
+    levels_.emplace_back(num_nodes * kDigestWords);
+    if (num_nodes == 1) break;
+    num_nodes = (num_nodes + 1) / 2;
+  }
+
+  for (uint64_t chunk = 0; chunk < NumChunks(); ++chunk) {
+    HashChunk(bytes, chunk);
+  }
+  for (size_t level = 1; level < levels_.size(); ++level) {
+    const uint64_t num_nodes = levels_[level].size() / kDigestWords;
+    for (uint64_t node = 0; node < num_nodes; ++node) {
+      HashNode(level, node);
+    }
+  }
+  HashRoot();
+}
+
+void HighwayMerkleTree::UpdateRange(const uint8_t* bytes, const uint64_t offset,
+                                    uint64_t num_bytes) {
+  if (offset >= size_) return;
+  num_bytes = std::min(num_bytes, size_ - offset);
+  if (num_bytes == 0) return;
+  uint64_t first = offset / chunk_size_;
+  uint64_t last = (offset + num_bytes - 1) / chunk_size_;
+  for (uint64_t chunk = first; chunk <= last; ++chunk) {
+    HashChunk(bytes, chunk);
+  }
+
+  // Only the ancestors of the modified chunks change.
+  for (size_t level = 1; level < levels_.size(); ++level) {
+    first /= 2;
+    last /= 2;
+    for (uint64_t node = first; node <= last; ++node) {
+      HashNode(level, node);
+    }
+  }
+  HashRoot();
+}
+
+std::vector<uint64_t> HighwayMerkleTree::Proof(uint64_t chunk) const {
+  std::vector<uint64_t> proof;
+  for (size_t level = 0; level + 1 < levels_.size(); ++level) {
+    const uint64_t sibling = chunk ^ 1;
+    if (sibling < levels_[level].size() / kDigestWords) {
+      const uint64_t* digest = &levels_[level][sibling * kDigestWords];
+      proof.insert(proof.end(), digest, digest + kDigestWords);
+    }
+    chunk /= 2;
+  }
+  return proof;
+}
+
+bool HighwayMerkleTree::VerifyChunk(const uint64_t (&key)[8],
+                                    const uint64_t size,
+                                    uint64_t chunk_size, uint64_t chunk,
+                                    const uint8_t* chunk_bytes,
+                                    const std::vector<uint64_t>& proof,
+                                    const uint64_t* root) {
+  chunk_size = ValidChunkSize(chunk_size);
+  uint64_t num_nodes = ::NumChunks(size, chunk_size);
+  if (chunk >= num_nodes) return false;
+
+  uint64_t digest[kDigestWords];
+  const uint64_t begin = chunk * chunk_size;
+  Digest(key, chunk_bytes, std::min(chunk_size, size - begin), digest);
+
+  uint64_t node_key[8];
+  DeriveKey(key, kNodeKey, node_key);
+  size_t used = 0;
+  while (num_nodes > 1) {
+    const uint64_t sibling = chunk ^ 1;
+    if (sibling < num_nodes) {
+      if (used + kDigestWords > proof.size()) return false;
+      const uint64_t* sibling_digest = &proof[used];
+      used += kDigestWords;
+      if (chunk & 1) {
+        NodeDigest(node_key, sibling_digest, digest, digest);
+      } else {
+        NodeDigest(node_key, digest, sibling_digest, digest);
+      }
+    }
+    chunk /= 2;
+    num_nodes = (num_nodes + 1) / 2;
+  }
+  if (used != proof.size()) return false;
+
+  uint64_t root_key[8];
+  DeriveKey(key, kRootKey, root_key);
+  uint64_t expected[kDigestWords];
+  RootDigest(root_key, digest, size, expected);
+  return memcmp(expected, root, kDigestSize) == 0;
+}
+
+void HighwayMerkleTree::HashChunk(const uint8_t* bytes, const uint64_t chunk) {
+  const uint64_t begin = chunk * chunk_size_;
+  Digest(key_, bytes + begin, std::min(chunk_size_, size_ - begin),
+         &levels_[0][chunk * kDigestWords]);
+}
+
+void HighwayMerkleTree::HashNode(const size_t level, const uint64_t node) {
+  uint64_t node_key[8];
+  DeriveKey(key_, kNodeKey, node_key);
+  const std::vector<uint64_t>& children = levels_[level - 1];
+  const uint64_t right = 2 * node + 1;
+  NodeDigest(node_key, &children[2 * node * kDigestWords],
+             right < children.size() / kDigestWords
+                 ? &children[right * kDigestWords]
+                 : nullptr,
+             &levels_[level][node * kDigestWords]);
+}
+
+void HighwayMerkleTree::HashRoot() {
+  uint64_t root_key[8];
+  DeriveKey(key_, kRootKey, root_key);
+  RootDigest(root_key, levels_.back().data(), size_, root_);
+}
@@ -0,0 +1,85 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_HIGHWAY_MERKLE_TREE_H_
+#define HIGHWAYHASH_HIGHWAY_MERKLE_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Merkle tree of HighwayTreeHash512 digests for large mutable data, e.g.
+// files. After modifying part of the data, UpdateRange only re-hashes the
+// affected chunks and their ancestors: O(modified bytes + log(size)) rather
+// than O(size). Individual chunks can be verified against the root using a
+// proof of O(log(size)) sibling digests.
+//
+// Definition: the data is split into chunks of "chunk_size" bytes (the last
+// may be shorter; empty data has one empty chunk). Leaf digests are
+// HighwayTreeHash512(key, chunk). Each interior node is the
+// HighwayTreeHash512 of its two children, using a derived key; a node
+// without a right sibling is copied to the next level unchanged. The root
+// hashes the topmost node and the size of the data with another derived
+// key. All digests are truncated to kDigestWords (256 bits).
+//
+// The tree does not own the data; callers pass the current contents to
+// UpdateRange. The size of the data is fixed at construction.
+class HighwayMerkleTree {
+ public:
+  static const int kDigestWords = 4;
+  static const uint64_t kDefaultChunkSize = 4096;
+
+  // Hashes all chunks of the "size" bytes at "bytes". A "chunk_size" of 0
+  // (here and in VerifyChunk) selects kDefaultChunkSize.
+  HighwayMerkleTree(const uint64_t (&key)[8], const uint8_t* bytes,
+                    const uint64_t size,
+                    const uint64_t chunk_size = kDefaultChunkSize);
+
+  // Call after modifying bytes [offset, offset + num_bytes). "bytes" points
+  // to the entire (modified) data, which is read from the start of the first
+  // to the end of the last affected chunk. The range is clipped to the size
+  // passed to the constructor, which cannot change.
+  void UpdateRange(const uint8_t* bytes, const uint64_t offset,
+                   const uint64_t num_bytes);
+
+  // Returns kDigestWords words identifying the key and entire data.
+  const uint64_t* Root() const { return root_; }
+
+  uint64_t NumChunks() const { return levels_[0].size() / kDigestWords; }
+
+  // Returns the digests required to verify "chunk", in bottom-up order.
+  std::vector<uint64_t> Proof(const uint64_t chunk) const;
+
+  // Returns whether "chunk_bytes" are the contents of chunk number "chunk"
+  // (of data with the given "size" and "chunk_size") in the tree with the
+  // given root. Does not require the tree itself, only Proof(chunk).
+  static bool VerifyChunk(const uint64_t (&key)[8], const uint64_t size,
+                          const uint64_t chunk_size, const uint64_t chunk,
+                          const uint8_t* chunk_bytes,
+                          const std::vector<uint64_t>& proof,
+                          const uint64_t* root);
+
+ private:
+  void HashChunk(const uint8_t* bytes, const uint64_t chunk);
+  void HashNode(const size_t level, const uint64_t node);
+  void HashRoot();
+
+  uint64_t key_[8];
+  uint64_t size_;
+  uint64_t chunk_size_;
+  // levels_[0] holds the chunk digests, levels_.back() the topmost node.
+  std::vector<std::vector<uint64_t>> levels_;
+  uint64_t root_[kDigestWords];
+};
+
+#endif  // #ifndef HIGHWAYHASH_HIGHWAY_MERKLE_TREE_H_
@@ -12,8 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "highway_tree_hash.h"
+#include "dispatch.h"
 
+#include <algorithm>
 #include <cstring>  // memcpy
 #include "vec2.h"
 
@@ -55,6 +56,26 @@ def x(a,b,c):
     mul1 = init1;
   }
 
+  // Leaves the state uninitialized; used together with Restore.
+  INLINE HighwayTreeHashState() {}
+
+  // Copies the state to/from 16 uint64_t (possibly unaligned) so that
+  // hashing can be resumed later, e.g. by HighwayTreeHashStream. The layout
+  // matches ScalarHighwayTreeHashState.
+  INLINE void Save(uint64_t* RESTRICT words) const {
+    StoreU(v0, words + 0);
+    StoreU(v1, words + 4);
+    StoreU(mul0, words + 8);
+    StoreU(mul1, words + 12);
+  }
+
+  INLINE void Restore(const uint64_t* RESTRICT words) {
+    v0 = LoadU(words + 0);
+    v1 = LoadU(words + 4);
+    mul0 = LoadU(words + 8);
+    mul1 = LoadU(words + 12);
+  }
+
   INLINE void Update(const V4x64U& packet) {
     v1 += packet;
     v1 += mul0;
@@ -81,6 +102,15 @@ def x(a,b,c):
     PermuteAndUpdate();
     PermuteAndUpdate();
 
+    return Digest();
+  }
+
+  INLINE void PermuteAndUpdate() {
+    Update(Permute(v0));
+  }
+
+  // Returns the hash; only valid after four calls to PermuteAndUpdate.
+  INLINE uint64_t Digest() const {
     // Much faster than Store(v0 + v1) to uint64_t[].
     return _mm_cvtsi128_si64(_mm256_extracti128_si256(v0 + v1 + mul0 + mul1, 0));
   }
@@ -111,10 +141,6 @@ def x(a,b,c):
     return V4x64U(_mm256_permutevar8x32_epi32(v, indices));
   }
 
-  INLINE void PermuteAndUpdate() {
-    Update(Permute(v0));
-  }
-
   V4x64U v0;
   V4x64U v1;
   V4x64U mul0;
@@ -163,10 +189,63 @@ static INLINE V4x64U LoadFinalPacket32(const uint8_t* bytes,
   return packet;
 }
 
+// Number of independent states updated in lockstep by HighwayTreeHashBatch.
+// More would exceed the 16 vector registers.
+const int kBatchStates = 4;
+
+// Hashes kNumStates inputs. "initial" is the state after key setup, which
+// is the same for all of them.
+template <int kNumStates>
+static INLINE void HashBatch(const HighwayTreeHashState& initial,
+                             const uint8_t* const* bytes,
+                             const uint64_t* sizes, uint64_t* hashes) {
+  HighwayTreeHashState states[kNumStates];
+  uint64_t num_packets[kNumStates];
+  uint64_t min_packets = ~0ULL;
+  for (int i = 0; i < kNumStates; ++i) {
+    states[i] = initial;
+    num_packets[i] = sizes[i] / kPacketSize;
+    min_packets = std::min(min_packets, num_packets[i]);
+  }
+
+  // Packets that all inputs have in common.
+  for (uint64_t packet = 0; packet < min_packets; ++packet) {
+    for (int i = 0; i < kNumStates; ++i) {
+      const uint64_t* packets = reinterpret_cast<const uint64_t*>(bytes[i]);
+      states[i].Update(LoadU(packets + packet * kNumLanes));
+    }
+  }
+
+  // Any additional packets of longer inputs.
+  for (int i = 0; i < kNumStates; ++i) {
+    const uint64_t* packets = reinterpret_cast<const uint64_t*>(bytes[i]);
+    for (uint64_t packet = min_packets; packet < num_packets[i]; ++packet) {
+      states[i].Update(LoadU(packets + packet * kNumLanes));
+    }
+  }
+
+  for (int i = 0; i < kNumStates; ++i) {
+    const size_t remainder = sizes[i] & (kPacketSize - 1);
+    const size_t truncated_size = sizes[i] - remainder;
+    states[i].Update(
+        LoadFinalPacket32(bytes[i] + truncated_size, sizes[i], remainder));
+  }
+
+  // Finalize is a serial chain of four updates; interleave the chains.
+  for (int round = 0; round < 4; ++round) {
+    for (int i = 0; i < kNumStates; ++i) {
+      states[i].PermuteAndUpdate();
+    }
+  }
+  for (int i = 0; i < kNumStates; ++i) {
+    hashes[i] = states[i].Digest();
+  }
+}
+
 }  // namespace
 
-uint64_t HighwayTreeHash(const uint64_t (&key)[kNumLanes], const uint8_t* bytes,
-                         const uint64_t size) {
+uint64_t AVX2HighwayTreeHash(const uint64_t (&key)[kNumLanes],
+                             const uint8_t* bytes, const uint64_t size) {
   HighwayTreeHashState state(key);
 
   const size_t remainder = size & (kPacketSize - 1);
@@ -183,3 +262,46 @@ uint64_t HighwayTreeHash(const uint64_t (&key)[kNumLanes], const uint8_t* bytes,
 
   return state.Finalize();
 }
+
+void AVX2HighwayTreeHashBatch(const uint64_t (&key)[kNumLanes],
+                              const uint8_t* const* bytes,
+                              const uint64_t* sizes, const uint64_t num,
+                              uint64_t* hashes) {
+  const HighwayTreeHashState initial(key);
+
+  uint64_t i = 0;
+  for (; i + kBatchStates <= num; i += kBatchStates) {
+    HashBatch<kBatchStates>(initial, bytes + i, sizes + i, hashes + i);
+  }
+  for (; i < num; ++i) {
+    HashBatch<1>(initial, bytes + i, sizes + i, hashes + i);
+  }
+}
+
+void AVX2HighwayTreeHashReset(const uint64_t (&key)[kNumLanes],
+                              uint64_t* state) {
+  HighwayTreeHashState(key).Save(state);
+}
+
+void AVX2HighwayTreeHashUpdate(const uint8_t* packets,
+                               const uint64_t num_packets, uint64_t* state) {
+  HighwayTreeHashState resumed;
+  resumed.Restore(state);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(packets);
+  for (uint64_t i = 0; i < num_packets * kNumLanes; i += kNumLanes) {
+    const V4x64U packet = LoadU(words + i);
+    resumed.Update(packet);
+  }
+  resumed.Save(state);
+}
+
+uint64_t AVX2HighwayTreeHashFinalize(const uint64_t* state,
+                                     const uint8_t* final_bytes,
+                                     const uint64_t size) {
+  HighwayTreeHashState resumed;
+  resumed.Restore(state);
+  const size_t remainder = size & (kPacketSize - 1);
+  const V4x64U final_packet = LoadFinalPacket32(final_bytes, size, remainder);
+  resumed.Update(final_packet);
+  return resumed.Finalize();
+}
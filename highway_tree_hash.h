@@ -16,6 +16,7 @@
 #define HIGHWAYHASH_HIGHWAY_TREE_HASH_H_
 
 #include <cstdint>
+#include "code_annotation.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,7 +25,8 @@ extern "C" {
 // J-lanes tree hash based upon multiplication and "zipper merges".
 //
 // Robust versus timing attacks because memory accesses are sequential
-// and the algorithm is branch-free. Requires an AVX-2 capable CPU.
+// and the algorithm is branch-free. Uses AVX-2 if the CPU supports it,
+// otherwise a portable implementation with identical results.
 //
 // "key" is a secret 256-bit key unknown to attackers.
 // "bytes" is the data to hash (possibly unaligned).
@@ -34,8 +36,43 @@ extern "C" {
 uint64_t HighwayTreeHash(const uint64_t (&key)[4], const uint8_t* bytes,
                          const uint64_t size);
 
+// Computes hashes[i] = HighwayTreeHash(key, bytes[i], sizes[i]) for all
+// i < num. Faster than separate calls for short inputs (e.g. hash table
+// keys) because several independent states are updated in lockstep, which
+// hides the latency of their multiplications and shuffles.
+void HighwayTreeHashBatch(const uint64_t (&key)[4], const uint8_t* const* bytes,
+                          const uint64_t* sizes, const uint64_t num,
+                          uint64_t* hashes);
+
 #ifdef __cplusplus
 }  // extern "C"
-#endif
+
+// Incremental version of HighwayTreeHash for inputs that arrive in pieces,
+// e.g. network packets. The digest equals that of HighwayTreeHash for the
+// concatenated input, regardless of how it was split into Update calls.
+// Partial 32-byte packets are buffered internally.
+class HighwayTreeHashStream {
+ public:
+  explicit HighwayTreeHashStream(const uint64_t (&key)[4]) { Reset(key); }
+
+  // Discards all previous input and begins a new message.
+  void Reset(const uint64_t (&key)[4]);
+
+  // Appends "size" bytes (possibly unaligned); exactly that many are read.
+  void Update(const uint8_t* bytes, const uint64_t size);
+
+  // Returns the hash of all bytes passed to Update since Reset. Does not
+  // modify the state, so Update may be called again to extend the message.
+  uint64_t Finalize() const;
+
+ private:
+  // HighwayTreeHashState: v0, v1, mul0, mul1.
+  ALIGNED(uint64_t, 32) state_[16];
+  // The first (size_ % 32) bytes are the current partial packet.
+  ALIGNED(uint8_t, 32) buffer_[32];
+  uint64_t size_;  // Total number of bytes since Reset.
+};
+
+#endif  // __cplusplus
 
 #endif  // #ifndef HIGHWAYHASH_HIGHWAY_TREE_HASH_H_
@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "highway_tree_hash512.h"
+#include "dispatch.h"
 
 #include <cstring>  // memcpy
 #include <stdio.h>
@@ -45,6 +45,26 @@ class HighwayTreeHashState512 {
     v3 = init0 ^ init1;
   }
 
+  // Leaves the state uninitialized; used together with Restore.
+  INLINE HighwayTreeHashState512() {}
+
+  // Copies the state to/from 16 uint64_t (possibly unaligned) so that
+  // hashing can be resumed later, e.g. by HighwayTreeHashStream512. The
+  // layout matches the scalar HighwayTreeHashState512.
+  INLINE void Save(uint64_t* RESTRICT words) const {
+    StoreU(v0, words + 0);
+    StoreU(v1, words + 4);
+    StoreU(v2, words + 8);
+    StoreU(v3, words + 12);
+  }
+
+  INLINE void Restore(const uint64_t* RESTRICT words) {
+    v0 = LoadU(words + 0);
+    v1 = LoadU(words + 4);
+    v2 = LoadU(words + 8);
+    v3 = LoadU(words + 12);
+  }
+
   inline void Update(const V4x64U& packet1, const V4x64U& packet2) {
     V4x64U mul0(_mm256_mul_epu32(v0, Permute(v2)));
     V4x64U mul1(_mm256_mul_epu32(v1, Permute(v3)));
@@ -205,8 +225,8 @@ class HighwayTreeHashState512 {
 
 }  // namespace
 
-void HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
-                        const uint64_t size, uint64_t out[8]) {
+void AVX2HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                            const uint64_t size, uint64_t out[8]) {
   HighwayTreeHashState512 state(key);
 
   size_t num_full_packets = size >> kPacketShift;
@@ -225,3 +245,32 @@ void HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
   }
   state.Finalize(out);
 }
+
+void AVX2HighwayTreeHash512Reset(const uint64_t (&key)[8], uint64_t* state) {
+  HighwayTreeHashState512(key).Save(state);
+}
+
+void AVX2HighwayTreeHash512Update(const uint8_t* packets,
+                                  const uint64_t num_packets,
+                                  uint64_t* state) {
+  HighwayTreeHashState512 resumed;
+  resumed.Restore(state);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(packets);
+  for (uint64_t i = 0; i < num_packets; ++i) {
+    resumed.UpdatePacket(words);
+    words += kPacketSize / sizeof(uint64_t);
+  }
+  resumed.Save(state);
+}
+
+void AVX2HighwayTreeHash512Finalize(const uint64_t* state,
+                                    const uint8_t* final_bytes,
+                                    const uint64_t remainder, uint64_t out[8]) {
+  HighwayTreeHashState512 resumed;
+  resumed.Restore(state);
+  if (remainder > 0) {
+    resumed.UpdateFinalPacket(reinterpret_cast<const uint64_t*>(final_bytes),
+                              remainder);
+  }
+  resumed.Finalize(out);
+}
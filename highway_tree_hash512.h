@@ -16,11 +16,13 @@
 #define HIGHWAYHASH_HIGHWAY_TREE_HASH512_H_
 
 #include <cstdint>
+#include "code_annotation.h"
 
 // J-lanes tree hash based upon multiplication and "zipper merges".
 //
 // Robust versus timing attacks because memory accesses are sequential
-// and the algorithm is branch-free. Requires an AVX-2 capable CPU.
+// and the algorithm is branch-free. Uses AVX-2 if the CPU supports it,
+// otherwise a portable implementation with identical results.
 //
 // "key" is a secret 256-bit key unknown to attackers.
 // "bytes" is the data to hash (possibly unaligned).
@@ -30,4 +32,32 @@
 void HighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
                         const uint64_t size, uint64_t out[8]);
 
+// Incremental version of HighwayTreeHash512 for inputs whose total size is
+// not known in advance, e.g. files or sockets. The digest equals that of
+// HighwayTreeHash512 for the concatenated input, regardless of how it was
+// split into Update calls. Because the final packet is hashed differently,
+// the most recent (possibly whole) 512-byte packet is held back until more
+// input arrives or Finalize is called.
+class HighwayTreeHashStream512 {
+ public:
+  explicit HighwayTreeHashStream512(const uint64_t (&key)[8]) { Reset(key); }
+
+  // Discards all previous input and begins a new message.
+  void Reset(const uint64_t (&key)[8]);
+
+  // Appends "size" bytes (possibly unaligned); exactly that many are read.
+  void Update(const uint8_t* bytes, const uint64_t size);
+
+  // Stores the hash of all bytes passed to Update since Reset. Does not
+  // modify the state, so Update may be called again to extend the message.
+  void Finalize(uint64_t out[8]) const;
+
+ private:
+  // HighwayTreeHashState512: v0, v1, v2, v3.
+  ALIGNED(uint64_t, 32) state_[16];
+  // The first buffered_ (0..512) bytes are the held-back packet.
+  ALIGNED(uint8_t, 64) buffer_[512];
+  uint64_t buffered_;
+};
+
 #endif  // #ifndef HIGHWAYHASH_HIGHWAY_TREE_HASH512_H_
@@ -0,0 +1,364 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "async_reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+AlignedBuffers::AlignedBuffers(const int depth, const size_t block_size)
+    : bytes_(nullptr), block_size_(block_size) {
+  void* bytes;
+  if (posix_memalign(&bytes, kReadAlignment, depth * block_size) == 0) {
+    bytes_ = static_cast<uint8_t*>(bytes);
+  }
+}
+
+AlignedBuffers::~AlignedBuffers() { free(bytes_); }
+
+// IORING_OP_READ is an enumerator; FAST_POLL was added in the same release.
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+
+// The submission and completion queues shared with the kernel. This is the
+// subset of liburing that UringReader needs, so there is no dependency.
+struct UringReader::Ring {
+  void* sq_map = MAP_FAILED;
+  size_t sq_map_size = 0;
+  void* cq_map = MAP_FAILED;
+  size_t cq_map_size = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_size = 0;
+
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  io_uring_cqe* cqes;
+};
+
+namespace {
+
+int UringSetup(const unsigned entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int UringEnter(const int ring_fd, const unsigned to_submit,
+               const unsigned min_complete, const unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+uint8_t* Offset(void* base, const uint32_t offset) {
+  return static_cast<uint8_t*>(base) + offset;
+}
+
+}  // namespace
+
+UringReader::UringReader(const int fd, const uint64_t size, const int depth,
+                         const size_t block_size)
+    : fd_(fd),
+      size_(size),
+      depth_(depth),
+      block_size_(block_size),
+      buffers_(depth, block_size),
+      completed_(depth, -1),
+      num_blocks_((size + block_size - 1) / block_size) {
+  if (buffers_[0] == nullptr) return;
+  io_uring_params params = {};
+  const int ring_fd = UringSetup(depth, &params);
+  if (ring_fd < 0) return;
+
+  ring_ = new Ring;
+  ring_->sq_map_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring_->cq_map_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  ring_->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  ring_->sq_map = mmap(nullptr, ring_->sq_map_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  ring_->cq_map = mmap(nullptr, ring_->cq_map_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  ring_->sqes = static_cast<io_uring_sqe*>(
+      mmap(nullptr, ring_->sqes_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+  if (ring_->sq_map == MAP_FAILED || ring_->cq_map == MAP_FAILED ||
+      ring_->sqes == MAP_FAILED) {
+    close(ring_fd);
+    return;
+  }
+  ring_->sq_tail = reinterpret_cast<unsigned*>(
+      Offset(ring_->sq_map, params.sq_off.tail));
+  ring_->sq_mask = reinterpret_cast<unsigned*>(
+      Offset(ring_->sq_map, params.sq_off.ring_mask));
+  ring_->sq_array = reinterpret_cast<unsigned*>(
+      Offset(ring_->sq_map, params.sq_off.array));
+  ring_->cq_head = reinterpret_cast<unsigned*>(
+      Offset(ring_->cq_map, params.cq_off.head));
+  ring_->cq_tail = reinterpret_cast<unsigned*>(
+      Offset(ring_->cq_map, params.cq_off.tail));
+  ring_->cq_mask = reinterpret_cast<unsigned*>(
+      Offset(ring_->cq_map, params.cq_off.ring_mask));
+  ring_->cqes = reinterpret_cast<io_uring_cqe*>(
+      Offset(ring_->cq_map, params.cq_off.cqes));
+  ring_fd_ = ring_fd;
+
+  const uint64_t num_initial = std::min<uint64_t>(depth_, num_blocks_);
+  for (uint64_t block = 0; block < num_initial; ++block) {
+    Queue(block);
+  }
+  while (num_queued_ != 0 && Enter(0)) {
+  }
+  // Unusable (see Ok) if not even the first read can be submitted.
+  if (num_blocks_ != 0 && num_in_flight_ == 0) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+UringReader::~UringReader() {
+  if (ring_fd_ >= 0) {
+    // The kernel may still write to buffers of reads in flight.
+    while (num_in_flight_ != 0) {
+      const unsigned head = *ring_->cq_head;
+      if (head != __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(ring_->cq_head, head + 1, __ATOMIC_RELEASE);
+        --num_in_flight_;
+      } else if (UringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+                 errno != EINTR) {
+        break;
+      }
+    }
+    close(ring_fd_);
+  }
+  if (ring_ != nullptr) {
+    if (ring_->sq_map != MAP_FAILED) munmap(ring_->sq_map, ring_->sq_map_size);
+    if (ring_->cq_map != MAP_FAILED) munmap(ring_->cq_map, ring_->cq_map_size);
+    if (ring_->sqes != MAP_FAILED) munmap(ring_->sqes, ring_->sqes_size);
+    delete ring_;
+  }
+}
+
+void UringReader::Queue(const uint64_t block) {
+  const int buffer = block % depth_;
+  completed_[buffer] = -1;
+  const unsigned tail = *ring_->sq_tail;
+  const unsigned index = tail & *ring_->sq_mask;
+  io_uring_sqe* sqe = &ring_->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uintptr_t>(buffers_[buffer]);
+  // Whole blocks even at the end of the file, as O_DIRECT requires.
+  sqe->len = block_size_;
+  sqe->off = block * block_size_;
+  sqe->user_data = block;
+  ring_->sq_array[index] = index;
+  __atomic_store_n(ring_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++num_queued_;
+}
+
+bool UringReader::Enter(const unsigned min_complete) {
+  const int submitted =
+      UringEnter(ring_fd_, num_queued_, min_complete,
+                 min_complete != 0 ? IORING_ENTER_GETEVENTS : 0);
+  if (submitted >= 0) {
+    num_queued_ -= submitted;
+    num_in_flight_ += submitted;
+    return true;
+  }
+  if (errno == EINTR) return true;
+  // Out of resources until reads complete; the queued reads remain in the
+  // ring and are submitted by the next call.
+  if ((errno == EAGAIN || errno == EBUSY) && num_in_flight_ != 0) {
+    return UringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) >= 0 ||
+           errno == EINTR;
+  }
+  return false;
+}
+
+bool UringReader::Reap() {
+  unsigned head = *ring_->cq_head;
+  while (head == __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE)) {
+    if (num_queued_ == 0 && num_in_flight_ == 0) {
+      errno = EIO;  // Nothing to wait for; cannot happen.
+      return false;
+    }
+    if (!Enter(1)) return false;
+  }
+  const io_uring_cqe& cqe = ring_->cqes[head & *ring_->cq_mask];
+  const uint64_t block = cqe.user_data;
+  const int result = cqe.res;
+  __atomic_store_n(ring_->cq_head, head + 1, __ATOMIC_RELEASE);
+  --num_in_flight_;
+  if (result < 0) {
+    errno = -result;
+    return false;
+  }
+
+  // Short reads are possible (e.g. signals); finish them synchronously.
+  // O_DIRECT requires aligned offsets, so re-read the last partial page.
+  uint8_t* buffer = buffers_[block % depth_];
+  const uint64_t offset = block * block_size_;
+  const size_t expected = std::min<uint64_t>(block_size_, size_ - offset);
+  size_t done = result;
+  while (done < expected) {
+    const size_t aligned = done & ~(kReadAlignment - 1);
+    const ssize_t bytes_read = pread(fd_, buffer + aligned,
+                                     block_size_ - aligned, offset + aligned);
+    if (bytes_read < 0 && errno == EINTR) continue;
+    if (bytes_read <= 0 || aligned + bytes_read <= done) {
+      if (bytes_read >= 0) errno = EIO;  // Truncated while reading.
+      return false;
+    }
+    done = aligned + bytes_read;
+  }
+  completed_[block % depth_] = expected;
+  return true;
+}
+
+bool UringReader::Next(const uint8_t** bytes, size_t* size) {
+  // The caller is done with the previous block, so reuse its buffer.
+  if (returned_block_ && next_block_ - 1 + depth_ < num_blocks_) {
+    Queue(next_block_ - 1 + depth_);
+    if (!Enter(0)) return false;
+  }
+  returned_block_ = false;
+  if (next_block_ == num_blocks_) {
+    *size = 0;
+    return true;
+  }
+  const int buffer = next_block_ % depth_;
+  while (completed_[buffer] < 0) {
+    if (!Reap()) return false;
+  }
+  *bytes = buffers_[buffer];
+  *size = completed_[buffer];
+  ++next_block_;
+  returned_block_ = true;
+  return true;
+}
+
+#else  // io_uring unavailable at compile time
+
+struct UringReader::Ring {};
+
+UringReader::UringReader(const int fd, const uint64_t size, const int depth,
+                         const size_t block_size)
+    : fd_(fd),
+      size_(size),
+      depth_(depth),
+      block_size_(block_size),
+      buffers_(1, kReadAlignment),
+      num_blocks_(0) {}
+
+UringReader::~UringReader() {}
+
+bool UringReader::Next(const uint8_t**, size_t*) {
+  errno = ENOSYS;
+  return false;
+}
+
+#endif
+
+ThreadReader::ThreadReader(const int fd, const int depth,
+                           const size_t block_size)
+    : fd_(fd),
+      depth_(depth),
+      block_size_(block_size),
+      buffers_(depth, block_size),
+      sizes_(depth),
+      errors_(depth) {
+  reader_ = std::thread([this] { ReadLoop(); });
+}
+
+ThreadReader::~ThreadReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  emptied_.notify_one();
+  reader_.join();
+}
+
+void ThreadReader::ReadLoop() {
+  for (uint64_t block = 0;; ++block) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      emptied_.wait(lock, [this, block] {
+        return exit_ || block < num_consumed_ + depth_;
+      });
+      if (exit_) return;
+    }
+
+    // Fill the whole buffer unless the file ends (pipes return less).
+    const int buffer = block % depth_;
+    int64_t size = 0;
+    int error = 0;
+    if (buffers_[0] == nullptr) {
+      size = -1;
+      error = ENOMEM;
+    }
+    while (size >= 0 && static_cast<size_t>(size) < block_size_) {
+      const ssize_t bytes_read =
+          read(fd_, buffers_[buffer] + size, block_size_ - size);
+      if (bytes_read < 0) {
+        if (errno == EINTR) continue;
+        size = -1;
+        error = errno;
+      } else if (bytes_read == 0) {
+        break;
+      } else {
+        size += bytes_read;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    sizes_[buffer] = size;
+    errors_[buffer] = error;
+    ++num_filled_;
+    filled_.notify_one();
+    // Stop after the end of the file or an error.
+    if (size <= 0) return;
+  }
+}
+
+bool ThreadReader::Next(const uint8_t** bytes, size_t* size) {
+  const uint64_t block = next_block_++;
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The caller is done with the previous block, so its buffer can be reused.
+  num_consumed_ = block;
+  emptied_.notify_one();
+  filled_.wait(lock, [this, block] { return num_filled_ > block; });
+  const int buffer = block % depth_;
+  if (sizes_[buffer] < 0) {
+    errno = errors_[buffer];
+    return false;
+  }
+  *bytes = buffers_[buffer];
+  *size = sizes_[buffer];
+  return true;
+}
@@ -0,0 +1,136 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HWSUM_ASYNC_READER_H_
+#define HIGHWAYHASH_HWSUM_ASYNC_READER_H_
+
+// Readers that return a file's blocks in order while further reads are in
+// flight, so that disk and CPU overlap: throughput approaches the slower of
+// the two instead of their harmonic mean. Both have the same interface:
+//   bool Next(const uint8_t** bytes, size_t* size)
+// sets "bytes" and "size" to the next block, which remains valid until the
+// next call, and returns false on read errors (errno is set). A "size" of
+// zero indicates the end of the file.
+//
+// Buffers are aligned to kReadAlignment, and blocks other than the last
+// are multiples of it, as O_DIRECT requires.
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const size_t kReadAlignment = 4096;
+
+// "depth" buffers of "block_size" (a multiple of kReadAlignment) bytes.
+class AlignedBuffers {
+ public:
+  AlignedBuffers(int depth, size_t block_size);
+  ~AlignedBuffers();
+
+  AlignedBuffers(const AlignedBuffers&) = delete;
+  AlignedBuffers& operator=(const AlignedBuffers&) = delete;
+
+  uint8_t* operator[](const int i) const {
+    return bytes_ + i * block_size_;
+  }
+
+ private:
+  uint8_t* bytes_;
+  const size_t block_size_;
+};
+
+// Keeps up to "depth" reads of a regular file in flight with io_uring.
+class UringReader {
+ public:
+  // Reads "size" bytes of "fd" starting at offset 0.
+  UringReader(int fd, uint64_t size, int depth, size_t block_size);
+  ~UringReader();
+
+  UringReader(const UringReader&) = delete;
+  UringReader& operator=(const UringReader&) = delete;
+
+  // Returns false if io_uring is unavailable (old kernel, seccomp, or
+  // disabled by the administrator) or refused the first read; the reader
+  // must then not be used.
+  bool Ok() const { return ring_fd_ >= 0; }
+
+  bool Next(const uint8_t** bytes, size_t* size);
+
+ private:
+  struct Ring;
+
+  // Adds the read of block "block" into buffer (block % depth) to the
+  // submission queue.
+  void Queue(uint64_t block);
+  // Submits the queued reads and waits for "min_complete" completions.
+  // Returns false on errors; queued reads may remain if resources are
+  // temporarily exhausted.
+  bool Enter(unsigned min_complete);
+  // Waits for the completion of a read; returns false on errors.
+  bool Reap();
+
+  const int fd_;
+  const uint64_t size_;
+  const int depth_;
+  const size_t block_size_;
+  AlignedBuffers buffers_;
+  int ring_fd_ = -1;
+  Ring* ring_ = nullptr;
+  // Bytes read into each buffer, or -1 while the read is in flight.
+  std::vector<int64_t> completed_;
+  uint64_t next_block_ = 0;  // Returned by the next call to Next.
+  uint64_t num_blocks_;
+  unsigned num_queued_ = 0;  // Not yet consumed by the kernel.
+  int num_in_flight_ = 0;
+  bool returned_block_ = false;  // Buffer of next_block_ - 1 may be reused.
+};
+
+// Fallback for pipes and kernels without io_uring: a thread that read()s
+// ahead into a ring of "depth" buffers.
+class ThreadReader {
+ public:
+  // Reads "fd" from its current position to the end.
+  ThreadReader(int fd, int depth, size_t block_size);
+  ~ThreadReader();
+
+  ThreadReader(const ThreadReader&) = delete;
+  ThreadReader& operator=(const ThreadReader&) = delete;
+
+  bool Next(const uint8_t** bytes, size_t* size);
+
+ private:
+  void ReadLoop();
+
+  const int fd_;
+  const int depth_;
+  const size_t block_size_;
+  AlignedBuffers buffers_;
+  uint64_t next_block_ = 0;  // Returned by the next call to Next.
+
+  std::mutex mutex_;
+  std::condition_variable filled_;
+  std::condition_variable emptied_;
+  // Bytes in each buffer; -1 (errno in errors_) on failure.
+  std::vector<int64_t> sizes_;
+  std::vector<int> errors_;
+  uint64_t num_filled_ = 0;    // Blocks read so far.
+  uint64_t num_consumed_ = 0;  // Blocks whose buffers may be reused.
+  bool exit_ = false;
+  std::thread reader_;
+};
+
+#endif  // #ifndef HIGHWAYHASH_HWSUM_ASYNC_READER_H_
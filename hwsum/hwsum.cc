@@ -1,44 +1,920 @@
-#include <stdio.h>
-#include "hwhash.h"
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
 
-constexpr size_t kBufSize = (1u << 14);
+// Prints the HighwayTreeHash512 digests (with an all-zero key) of files or
+// of stdin. Usage:
+//   hwsum [options] [file...]
+//   --files-from LIST  also hash the files named by the lines of LIST
+//                      ("-" for stdin)
+//   -j, --jobs N       number of worker threads
+//   --io METHOD        how to read regular files of at least 64 KiB:
+//                      mmap (default), read, uring (io_uring with several
+//                      reads in flight) or thread (a reader thread);
+//                      --no-mmap is short for --io read
+//   --direct           bypass the page cache (O_DIRECT) for named files;
+//                      implies --io uring unless --io thread is given
+//   --populate         prefault mappings (MAP_POPULATE)
+//   --huge-pages       ask for transparent huge pages
+//   --stats            report throughput to stderr
+//   -c, --check MANIFEST  verify the files listed by a previous run's
+//                      "digest  name" output ("-" for stdin); with
+//                      --fail-fast, stop at the first failure; --quiet
+//                      omits the "OK" lines. A summary goes to stderr.
+//   -r, --recursive    hash the regular files below directory arguments
+// Without file arguments, --files-from or -c, reads stdin. A single
+// file (or stdin, also named "-") prints only its digest; several print
+// "digest  name" lines in input order, like sha256sum.
+//
+// Regular files of at least 64 KiB (including stdin, unless it was already
+// partly read) are memory-mapped and hashed in place; smaller files and
+// pipes are read in large blocks. Files are hashed in parallel; workers
+// outnumber cores so that more reads are in flight.
+// The uring and thread methods instead overlap the reads of one file with
+// hashing (see async_reader.h); pipes then also use a reader thread.
+//
+// With -r, each directory is walked by a pool of threads that feeds the
+// hashing workers, so listing and hashing overlap. Its files are printed
+// sorted (bytewise) by relative path, then a "digest  dir/" line: the digest
+// of the concatenation, in that order, of each file's relative path (with "/"
+// separators), a zero byte, and its size and digest words as little-endian
+// uint64. Symbolic links and special files are skipped, and no aggregate is
+// printed for trees with unreadable entries.
 
-int main(int argc, char* argv[]) {
-    FILE *infile;
-    if (argc == 1) {
-        infile = stdin;
-    } else if (argc == 2) {
-        infile = fopen(argv[1], "rb");
-        if (infile == nullptr) {
-            printf("Unable to open file %s for reading\n", argv[1]);
-            return 1;
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "highway_tree_hash512.h"
+
+#include "async_reader.h"
+
+namespace {
+
+// Buffered reads use blocks of this size, which amortizes the syscalls.
+const size_t kReadSize = 1 << 20;
+
+// Smaller files are read instead of mapped: setting up and tearing down a
+// mapping costs more than copying a few pages.
+const uint64_t kMinMapSize = 64 << 10;
+
+// Mappings are hashed in windows of this size; the kernel is asked to read
+// the next window ahead while the current one is hashed.
+const size_t kWindowSize = 64 << 20;
+
+// Asynchronous readers keep up to kAsyncDepth reads of this size in flight.
+const size_t kAsyncBlockSize = 1 << 20;
+const int kAsyncDepth = 4;
+
+// Each worker takes up to this many names at a time, which amortizes the
+// synchronization for small files.
+const size_t kBatchSize = 8;
+
+// Finished results are printed in input order; at most this many (per
+// worker) are held back while waiting for an earlier, larger file.
+const size_t kWindowPerWorker = 64;
+
+enum class IO { kMmap, kRead, kUring, kThread };
+
+const char* const kIONames[] = {"mmap", "read", "uring", "thread"};
+
+struct Options {
+  int num_threads = 0;  // 0: default (see main)
+  IO io = IO::kMmap;
+  bool direct = false;
+  bool populate = false;
+  bool huge_pages = false;
+  bool stats = false;
+};
+
+double Seconds() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1E-9;
+}
+
+// Hashes the regular file "fd" of "size" bytes directly from its mapping.
+// Returns false if it cannot be mapped; the caller then reads it instead.
+bool HashMapped(const int fd, const uint64_t size, const Options& options,
+                HighwayTreeHashStream512* stream) {
+  if (size < kMinMapSize || size > SIZE_MAX) return false;
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if (options.populate) flags |= MAP_POPULATE;
+#endif
+  void* mapping = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+  if (mapping == MAP_FAILED) return false;
+  const uint8_t* bytes = static_cast<const uint8_t*>(mapping);
+
+  // Advice is only a hint, so errors are ignored.
+  (void)madvise(mapping, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  if (options.huge_pages) (void)madvise(mapping, size, MADV_HUGEPAGE);
+#endif
+  (void)madvise(mapping, std::min<uint64_t>(size, kWindowSize),
+                MADV_WILLNEED);
+  for (uint64_t pos = 0; pos < size; pos += kWindowSize) {
+    const uint64_t window = std::min<uint64_t>(size - pos, kWindowSize);
+    // Window boundaries are page-aligned, as madvise requires.
+    const uint64_t next = pos + window;
+    if (next < size) {
+      (void)madvise(const_cast<uint8_t*>(bytes) + next,
+                    std::min<uint64_t>(size - next, kWindowSize),
+                    MADV_WILLNEED);
+    }
+    stream->Update(bytes + pos, window);
+  }
+  munmap(mapping, size);
+  return true;
+}
+
+// Hashes the rest of "fd" (e.g. a pipe) using reads into "buffer" (reused
+// across files). Returns false on read errors; "size" is the number of bytes
+// hashed.
+bool HashRead(const int fd, std::vector<uint8_t>* buffer,
+              HighwayTreeHashStream512* stream, uint64_t* size) {
+  buffer->resize(kReadSize);
+  *size = 0;
+  for (;;) {
+    const ssize_t bytes_read = read(fd, buffer->data(), buffer->size());
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (bytes_read == 0) return true;
+    stream->Update(buffer->data(), bytes_read);
+    *size += bytes_read;
+  }
+}
+
+// Hashes the blocks returned by an asynchronous reader (see
+// async_reader.h). Returns false on read errors; "size" is the number of
+// bytes hashed.
+template <class Reader>
+bool HashBlocks(Reader* reader, HighwayTreeHashStream512* stream,
+                uint64_t* size) {
+  *size = 0;
+  for (;;) {
+    const uint8_t* bytes;
+    size_t block_size;
+    if (!reader->Next(&bytes, &block_size)) return false;
+    if (block_size == 0) return true;
+    stream->Update(bytes, block_size);
+    *size += block_size;
+  }
+}
+
+// A file to hash and, when checking a manifest, its expected digest.
+struct Entry {
+  std::string name;
+  bool has_expected = false;
+  uint64_t expected[8];
+  // For files found by TreeWalker: index of the tree, and the offset of the
+  // path relative to its root within "name".
+  int tree = -1;
+  size_t relative = 0;
+};
+
+struct Result {
+  Entry entry;
+  bool ok = false;
+  std::string error;
+  IO io = IO::kRead;  // How the file was actually read.
+  uint64_t size = 0;
+  uint64_t hash[8];
+};
+
+// Hashes the file entry.name ("-" is stdin) into "result". "buffer" is
+// scratch space for HashRead.
+void HashFile(const Entry& entry, const Options& options,
+              std::vector<uint8_t>* buffer, Result* result) {
+  result->entry = entry;
+  const std::string& name = entry.name;
+  int fd = STDIN_FILENO;
+  if (name != "-") {
+    fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      result->error = strerror(errno);
+      return;
+    }
+  }
+
+  uint64_t key[8] = {0,};
+  HighwayTreeHashStream512 stream(key);
+  struct stat info;
+  // Mappings and io_uring read from offset 0, so a stdin that was already
+  // partly consumed (e.g. by the shell) is hashed like a pipe.
+  const bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+                       lseek(fd, 0, SEEK_CUR) == 0;
+  const bool large = regular && uint64_t(info.st_size) >= kMinMapSize;
+  IO io = IO::kRead;
+  if (large) {
+    io = options.io;
+  } else if (!regular && options.io != IO::kRead) {
+    // Pipes benefit from reading ahead, but cannot be mapped.
+    io = IO::kThread;
+  }
+  // Not for stdin: its file description is shared with other processes.
+  if (large && options.direct && io != IO::kMmap && io != IO::kRead &&
+      fd != STDIN_FILENO) {
+    // Not all file systems support O_DIRECT; then use the page cache.
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) (void)fcntl(fd, F_SETFL, flags | O_DIRECT);
+  }
+  if (regular) {
+    result->size = info.st_size;
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  // Only as many buffers as the file needs.
+  const uint64_t num_blocks =
+      (result->size + kAsyncBlockSize - 1) / kAsyncBlockSize;
+  const int depth =
+      regular ? std::min<uint64_t>(kAsyncDepth, num_blocks) : kAsyncDepth;
+
+  if (io == IO::kMmap) {
+    result->ok = HashMapped(fd, result->size, options, &stream);
+    if (!result->ok) io = IO::kRead;
+  }
+  if (io == IO::kUring) {
+    UringReader reader(fd, result->size, depth, kAsyncBlockSize);
+    if (reader.Ok()) {
+      result->ok = HashBlocks(&reader, &stream, &result->size);
+    } else {
+      io = IO::kThread;
+    }
+  }
+  if (io == IO::kThread) {
+    ThreadReader reader(fd, std::max(depth, 2), kAsyncBlockSize);
+    result->ok = HashBlocks(&reader, &stream, &result->size);
+  }
+  if (io == IO::kRead) {
+    result->ok = HashRead(fd, buffer, &stream, &result->size);
+  }
+  result->io = io;
+  if (result->ok) {
+    stream.Finalize(result->hash);
+  } else {
+    result->error = strerror(errno);
+  }
+  if (fd != STDIN_FILENO) close(fd);
+}
+
+// Parses a "digest  name" line as printed by hwsum (or "digest *name").
+// Returns false if it is malformed.
+bool ParseManifestLine(const char* line, const size_t length, Entry* entry) {
+  const size_t kDigits = 16;
+  if (length < 8 * kDigits + 3) return false;
+  const char* separator = line + 8 * kDigits;
+  if (separator[0] != ' ' || (separator[1] != ' ' && separator[1] != '*')) {
+    return false;
+  }
+  for (int i = 0; i < 8; ++i) {
+    uint64_t word = 0;
+    for (size_t j = 0; j < kDigits; ++j) {
+      const char c = line[i * kDigits + j];
+      int digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      word = (word << 4) | digit;
+    }
+    entry->expected[i] = word;
+  }
+  entry->has_expected = true;
+  entry->name.assign(separator + 2, line + length);
+  return true;
+}
+
+// Outcome of fetching the next input: an entry, none yet (the walk is still
+// running), or none ever.
+enum class Fetch { kEntry, kPending, kEnd };
+
+// Lists the regular files below several directories ("trees") using a pool
+// of threads, each reading one directory at a time. Files are yielded in no
+// particular order while the walk continues.
+class TreeWalker {
+ public:
+  TreeWalker(const std::vector<std::string>& roots, const int num_threads)
+      : num_errors_(roots.size()) {
+    for (size_t tree = 0; tree < roots.size(); ++tree) {
+      std::string root = roots[tree];
+      while (root.size() > 1 && root.back() == '/') root.pop_back();
+      if (root != "/") root += '/';
+      directories_.push_back({static_cast<int>(tree), root, root.size()});
+    }
+    num_pending_ = directories_.size();
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this] { WalkLoop(); });
+    }
+  }
+
+  ~TreeWalker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    directory_ready_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Takes the next file found so far without waiting for the walk.
+  Fetch TryNext(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (files_.empty()) {
+      return num_pending_ == 0 ? Fetch::kEnd : Fetch::kPending;
+    }
+    Path& file = files_.front();
+    entry->name = std::move(file.path);
+    entry->has_expected = false;
+    entry->tree = file.tree;
+    entry->relative = file.relative;
+    files_.pop_front();
+    return Fetch::kEntry;
+  }
+
+  // Waits until TryNext would not return kPending.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    file_ready_.wait(lock, [this] {
+      return !files_.empty() || num_pending_ == 0;
+    });
+  }
+
+  // Returns the number of unlistable directories in "tree". Only valid
+  // after TryNext returned kEnd.
+  uint64_t NumErrors(const int tree) const { return num_errors_[tree]; }
+
+ private:
+  // A directory or file below the root of "tree".
+  struct Path {
+    int tree;
+    std::string path;  // Ends with '/' for directories.
+    size_t relative;
+  };
+
+  void WalkLoop() {
+    std::vector<Path> directories;
+    std::vector<Path> files;
+    for (;;) {
+      Path directory;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        directory_ready_.wait(lock, [this] {
+          return exit_ || !directories_.empty() || num_pending_ == 0;
+        });
+        if (exit_ || directories_.empty()) return;
+        directory = std::move(directories_.front());
+        directories_.pop_front();
+      }
+
+      const bool ok = List(directory, &directories, &files);
+      if (!ok) {
+        fprintf(stderr, "hwsum: %s: %s\n", directory.path.c_str(),
+                strerror(errno));
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ok) ++num_errors_[directory.tree];
+      for (Path& file : files) {
+        files_.push_back(std::move(file));
+      }
+      for (Path& subdirectory : directories) {
+        directories_.push_back(std::move(subdirectory));
+      }
+      num_pending_ += directories.size();
+      --num_pending_;
+      // Hashing workers also wait for the end of the walk.
+      file_ready_.notify_all();
+      if (!directories.empty() || num_pending_ == 0) {
+        directory_ready_.notify_all();
+      }
+    }
+  }
+
+  // Appends the subdirectories and regular files of "directory". Returns
+  // false if it cannot be read.
+  static bool List(const Path& directory,
+                   std::vector<Path>* directories,
+                   std::vector<Path>* files) {
+    directories->clear();
+    files->clear();
+    DIR* dir = opendir(directory.path.c_str());
+    if (dir == nullptr) return false;
+    for (;;) {
+      errno = 0;
+      const dirent* child = readdir(dir);
+      if (child == nullptr) break;
+      const char* name = child->d_name;
+      if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+      unsigned char type = child->d_type;
+      if (type == DT_UNKNOWN) {
+        // Some file systems do not report types; symbolic links are not
+        // followed.
+        struct stat info;
+        if (fstatat(dirfd(dir), name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+          continue;
         }
+        type = S_ISDIR(info.st_mode) ? DT_DIR
+               : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+      }
+      if (type == DT_DIR) {
+        directories->push_back({directory.tree, directory.path + name + '/',
+                                directory.relative});
+      } else if (type == DT_REG) {
+        files->push_back(
+            {directory.tree, directory.path + name, directory.relative});
+      }
     }
-    uint64_t key[8] = {0,};
-    HighwayTreeHashState512 state(key);
-    uint64_t *packets = new uint64_t[kBufSize/sizeof(uint64_t)];
-    uint64_t *p;
-    uint32_t numBytes;
-    do {
-        numBytes = sizeof(uint64_t)*fread(packets, sizeof(uint64_t), kBufSize/sizeof(uint64_t), infile);
-        uint32_t numPackets = numBytes/kPacketSize;
-        p = packets;
-        for(uint32_t i = 0; i < numPackets; i++, p += kPacketSize/sizeof(uint64_t)) {
-            state.UpdatePacket(p);
+    const int error = errno;
+    closedir(dir);
+    errno = error;
+    return error == 0;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable directory_ready_;
+  std::condition_variable file_ready_;
+  std::deque<Path> directories_;
+  std::deque<Path> files_;
+  // Directories queued or being listed.
+  uint64_t num_pending_;
+  std::vector<uint64_t> num_errors_;
+  bool exit_ = false;
+  std::vector<std::thread> threads_;  // Last: they use the other members.
+};
+
+// Yields the command-line names, then the lines of the --files-from list or
+// (if "manifest") the entries of a manifest to check, then the files found
+// by "walker" (if not null).
+class NameSource {
+ public:
+  NameSource(std::vector<std::string> names, FILE* list, bool manifest,
+             TreeWalker* walker)
+      : names_(std::move(names)),
+        list_(list),
+        manifest_(manifest),
+        walker_(walker) {}
+
+  ~NameSource() { free(line_); }
+
+  // Returns kPending if the walker has not found further files yet; then
+  // call Wait without holding the lock that serializes TryNext.
+  Fetch TryNext(Entry* entry) {
+    if (next_ < names_.size()) {
+      entry->name = names_[next_++];
+      entry->has_expected = false;
+      entry->tree = -1;
+      return Fetch::kEntry;
+    }
+    while (list_ != nullptr) {
+      ssize_t length = getline(&line_, &capacity_, list_);
+      if (length < 0) break;
+      if (length != 0 && line_[length - 1] == '\n') --length;
+      if (length == 0) continue;
+      entry->tree = -1;
+      if (!manifest_) {
+        entry->name.assign(line_, length);
+        entry->has_expected = false;
+        return Fetch::kEntry;
+      }
+      if (ParseManifestLine(line_, length, entry)) return Fetch::kEntry;
+      ++num_malformed_;
+    }
+    return walker_ == nullptr ? Fetch::kEnd : walker_->TryNext(entry);
+  }
+
+  void Wait() {
+    if (walker_ != nullptr) walker_->Wait();
+  }
+
+  // Returns the number of manifest lines skipped so far.
+  uint64_t NumMalformed() const { return num_malformed_; }
+
+ private:
+  std::vector<std::string> names_;
+  size_t next_ = 0;
+  FILE* list_;
+  const bool manifest_;
+  TreeWalker* walker_;
+  char* line_ = nullptr;
+  size_t capacity_ = 0;
+  uint64_t num_malformed_ = 0;
+};
+
+// Hashes the files from a NameSource on worker threads and passes the
+// results to a callback in input order. Workers only start names within a
+// window of the oldest unprinted result, which bounds the memory used for
+// reordering.
+class OrderedHasher {
+ public:
+  OrderedHasher(const Options& options, NameSource* source)
+      : options_(options),
+        source_(source),
+        window_(kWindowPerWorker * options.num_threads),
+        slots_(window_) {}
+
+  template <class Print>
+  void Run(const Print& print) {
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options_.num_threads; ++i) {
+      workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    for (;;) {
+      Slot& slot = slots_[num_printed_ % window_];
+      std::unique_lock<std::mutex> lock(mutex_);
+      result_ready_.wait(lock, [this, &slot] {
+        return slot.done || (input_done_ && num_printed_ == num_started_);
+      });
+      if (!slot.done) break;
+      Result result = std::move(slot.result);
+      slot.done = false;
+      ++num_printed_;
+      lock.unlock();
+      window_available_.notify_all();
+      print(result);
+    }
+
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Starts no further files; Run returns after the callback has received
+  // the results of those already started. May be called by the callback.
+  void Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_done_ = true;
+    result_ready_.notify_all();
+    window_available_.notify_all();
+  }
+
+ private:
+  struct Slot {
+    bool done = false;
+    Result result;
+  };
+
+  void WorkerLoop() {
+    std::vector<std::pair<uint64_t, Entry>> batch;
+    Entry entry;
+    std::vector<uint8_t> buffer;
+    for (;;) {
+      batch.clear();
+      bool pending = false;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        window_available_.wait(lock, [this] {
+          return input_done_ || num_started_ < num_printed_ + window_;
+        });
+        while (!input_done_ && batch.size() < kBatchSize &&
+               num_started_ < num_printed_ + window_) {
+          const Fetch fetch = source_->TryNext(&entry);
+          if (fetch == Fetch::kEntry) {
+            batch.emplace_back(num_started_++, entry);
+          } else if (fetch == Fetch::kEnd) {
+            input_done_ = true;
+            // The printer may be waiting for a result that will never come.
+            result_ready_.notify_all();
+          } else {
+            pending = true;
+            break;
+          }
+        }
+        if (batch.empty() && !pending) return;
+      }
+      // Wait for the directory walk without blocking other workers and the
+      // printer, which need the lock to publish and take results.
+      if (batch.empty()) {
+        source_->Wait();
+        continue;
+      }
+
+      for (const auto& item : batch) {
+        Result result;
+        HashFile(item.second, options_, &buffer, &result);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot& slot = slots_[item.first % window_];
+        slot.result = std::move(result);
+        slot.done = true;
+        result_ready_.notify_all();
+      }
+    }
+  }
+
+  const Options& options_;
+  NameSource* source_;
+  const uint64_t window_;
+
+  std::mutex mutex_;
+  std::condition_variable result_ready_;
+  std::condition_variable window_available_;
+  std::vector<Slot> slots_;
+  bool input_done_ = false;
+  uint64_t num_started_ = 0;
+  uint64_t num_printed_ = 0;
+};
+
+// Appends "word" to "bytes" in little-endian order.
+void AppendWord(const uint64_t word, std::vector<uint8_t>* bytes) {
+  for (int i = 0; i < 8; ++i) {
+    bytes->push_back(static_cast<uint8_t>(word >> (i * 8)));
+  }
+}
+
+// Prints the results for the files of a tree sorted by relative path, then
+// (if "complete") the tree digest (see the top of this file) as
+// "digest  root/".
+void PrintTree(const std::string& root, const bool complete,
+               std::vector<Result>* results) {
+  std::sort(results->begin(), results->end(),
+            [](const Result& a, const Result& b) {
+              return a.entry.name.compare(a.entry.relative, std::string::npos,
+                                          b.entry.name, b.entry.relative,
+                                          std::string::npos) < 0;
+            });
+  uint64_t key[8] = {0,};
+  HighwayTreeHashStream512 stream(key);
+  std::vector<uint8_t> record;
+  for (const Result& result : *results) {
+    for (int i = 0; i < 8; i++) {
+      printf("%016lx", result.hash[i]);
+    }
+    printf("  %s\n", result.entry.name.c_str());
+
+    const std::string& name = result.entry.name;
+    record.assign(name.begin() + result.entry.relative, name.end());
+    record.push_back(0);
+    AppendWord(result.size, &record);
+    for (int i = 0; i < 8; i++) {
+      AppendWord(result.hash[i], &record);
+    }
+    stream.Update(record.data(), record.size());
+  }
+  if (!complete) return;
+  uint64_t hash[8];
+  stream.Finalize(hash);
+  for (int i = 0; i < 8; i++) {
+    printf("%016lx", hash[i]);
+  }
+  printf("  %s%s\n", root.c_str(), root.back() == '/' ? "" : "/");
+}
+
+}  // namespace
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: hwsum [--files-from LIST] [-j N] [--io METHOD] [--direct] "
+          "[--populate] [--huge-pages] [--stats] [-r] [file...]\n"
+          "       hwsum -c MANIFEST [--fail-fast] [--quiet] [-j N] ...\n");
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  std::vector<std::string> names;
+  const char* files_from = nullptr;
+  const char* manifest = nullptr;
+  bool fail_fast = false;
+  bool quiet = false;
+  bool recursive = false;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    bool ok = true;
+    if (strcmp(argv[i], "--no-mmap") == 0) {
+      options.io = IO::kRead;
+    } else if (strcmp(argv[i], "--io") == 0 && has_value) {
+      const char* method = argv[++i];
+      ok = false;
+      for (int io = 0; io < 4; ++io) {
+        if (strcmp(method, kIONames[io]) == 0) {
+          options.io = static_cast<IO>(io);
+          ok = true;
         }
-    } while(numBytes == kBufSize);
-    const size_t remainder = numBytes & (kPacketSize - 1);
-    if (remainder > 0) {
-        uint64_t final_packet[kPacketSize / sizeof(uint64_t)] = {0,};
-        memcpy(final_packet, p, remainder);
-        state.UpdatePacket(final_packet);
-    }
-    ALIGNED(uint64_t, 64) hash[8];
-    state.Finalize(hash);
-    for(int i = 0; i < 8; i++) {
-        printf("%016lx", hash[i]);
-    }
-    putchar('\n');
-    fclose(infile);
-    return 0;
+      }
+    } else if (strcmp(argv[i], "--direct") == 0) {
+      options.direct = true;
+    } else if (strcmp(argv[i], "--populate") == 0) {
+      options.populate = true;
+    } else if (strcmp(argv[i], "--huge-pages") == 0) {
+      options.huge_pages = true;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      options.stats = true;
+    } else if (strcmp(argv[i], "--files-from") == 0 && has_value) {
+      files_from = argv[++i];
+    } else if ((strcmp(argv[i], "-c") == 0 ||
+                strcmp(argv[i], "--check") == 0) && has_value) {
+      manifest = argv[++i];
+    } else if (strcmp(argv[i], "--fail-fast") == 0) {
+      fail_fast = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "-r") == 0 ||
+               strcmp(argv[i], "--recursive") == 0) {
+      recursive = true;
+    } else if ((strcmp(argv[i], "-j") == 0 ||
+                strcmp(argv[i], "--jobs") == 0) && has_value) {
+      options.num_threads = atoi(argv[++i]);
+      ok = options.num_threads > 0 && options.num_threads <= 1024;
+    } else if (argv[i][0] != '-' || argv[i][1] == '\0') {
+      names.push_back(argv[i]);
+    } else {
+      ok = false;
+    }
+    // A manifest lists all files to check.
+    if (manifest != nullptr &&
+        (files_from != nullptr || !names.empty() || recursive)) {
+      ok = false;
+    }
+    if (!ok) {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  // With -r, directory arguments are walked; other names are hashed first.
+  std::vector<std::string> roots;
+  if (recursive) {
+    std::vector<std::string> files;
+    for (std::string& name : names) {
+      struct stat info;
+      if (name != "-" && stat(name.c_str(), &info) == 0 &&
+          S_ISDIR(info.st_mode)) {
+        roots.push_back(std::move(name));
+      } else {
+        files.push_back(std::move(name));
+      }
+    }
+    names.swap(files);
+  }
+
+  FILE* list = nullptr;
+  const char* list_name = manifest != nullptr ? manifest : files_from;
+  if (list_name != nullptr) {
+    list = strcmp(list_name, "-") == 0 ? stdin : fopen(list_name, "r");
+    if (list == nullptr) {
+      fprintf(stderr, "hwsum: %s: %s\n", list_name, strerror(errno));
+      return 1;
+    }
+  } else if (names.empty() && roots.empty()) {
+    names.push_back("-");
+  }
+  if (options.direct && options.io != IO::kThread) options.io = IO::kUring;
+  // Only a single input prints just the digest, as before.
+  const bool print_names =
+      list != nullptr || names.size() > 1 || !roots.empty();
+
+  // Workers mostly wait for I/O when the files are not cached, so use more
+  // of them than cores to keep several reads in flight.
+  if (options.num_threads == 0) {
+    const int num_cores = std::thread::hardware_concurrency();
+    options.num_threads = std::max(4, 2 * num_cores);
+  }
+
+  const double start = Seconds();
+  uint64_t num_files = 0;
+  uint64_t num_unreadable = 0;
+  uint64_t num_mismatched = 0;
+  uint64_t total_size = 0;
+  // Bytes read by each IO method, to report the one that was used.
+  uint64_t io_sizes[4] = {0};
+  bool stopped = false;
+  std::unique_ptr<TreeWalker> walker;
+  if (!roots.empty()) {
+    walker.reset(new TreeWalker(roots, options.num_threads));
+  }
+  // Results of the files in each tree, and how many could not be hashed.
+  std::vector<std::vector<Result>> trees(roots.size());
+  std::vector<uint64_t> num_unreadable_in_tree(roots.size());
+  NameSource source(std::move(names), list, manifest != nullptr,
+                    walker.get());
+  OrderedHasher hasher(options, &source);
+  hasher.Run([&](const Result& result) {
+    // Files that were already being hashed when --fail-fast stopped.
+    if (stopped) return;
+    ++num_files;
+    const char* name = result.entry.name.c_str();
+    bool failed = false;
+    if (!result.ok) {
+      ++num_unreadable;
+      if (result.entry.tree >= 0) ++num_unreadable_in_tree[result.entry.tree];
+      failed = true;
+      if (manifest != nullptr) {
+        printf("%s: FAILED open or read\n", name);
+        fprintf(stderr, "hwsum: %s: %s\n", name, result.error.c_str());
+      } else if (print_names) {
+        fprintf(stderr, "hwsum: %s: %s\n", name, result.error.c_str());
+      } else if (result.entry.name == "-") {
+        fprintf(stderr, "hwsum: read error: %s\n", result.error.c_str());
+      } else {
+        printf("Unable to open file %s for reading\n", name);
+      }
+    } else if (result.entry.has_expected) {
+      total_size += result.size;
+      if (memcmp(result.hash, result.entry.expected, sizeof(result.hash)) !=
+          0) {
+        ++num_mismatched;
+        failed = true;
+        printf("%s: FAILED\n", name);
+      } else if (!quiet) {
+        printf("%s: OK\n", name);
+      }
+    } else {
+      total_size += result.size;
+      io_sizes[static_cast<int>(result.io)] += result.size;
+      if (result.entry.tree >= 0) {
+        // Printed in sorted order once the whole tree is hashed.
+        trees[result.entry.tree].push_back(result);
+        return;
+      }
+      for (int i = 0; i < 8; i++) {
+        printf("%016lx", result.hash[i]);
+      }
+      if (print_names) {
+        printf("  %s", name);
+      }
+      putchar('\n');
+    }
+    if (failed && fail_fast) {
+      stopped = true;
+      hasher.Stop();
+    }
+  });
+  for (size_t tree = 0; tree < roots.size(); ++tree) {
+    const uint64_t num_errors =
+        num_unreadable_in_tree[tree] + walker->NumErrors(tree);
+    PrintTree(roots[tree], num_errors == 0, &trees[tree]);
+    if (num_errors != 0) {
+      // Unreadable files were already counted.
+      num_unreadable += walker->NumErrors(tree);
+      fflush(stdout);
+      fprintf(stderr, "hwsum: %s: no tree digest (%llu unreadable)\n",
+              roots[tree].c_str(), static_cast<unsigned long long>(num_errors));
+    }
+  }
+  const double elapsed = Seconds() - start;
+
+  if (manifest != nullptr) {
+    fflush(stdout);
+    fprintf(stderr,
+            "hwsum: %llu files checked: %llu OK, %llu FAILED, %llu "
+            "unreadable%s; %llu bytes in %.3f s = %.2f GB/s\n",
+            static_cast<unsigned long long>(num_files),
+            static_cast<unsigned long long>(num_files - num_mismatched -
+                                            num_unreadable),
+            static_cast<unsigned long long>(num_mismatched),
+            static_cast<unsigned long long>(num_unreadable),
+            stopped ? " (stopped at first failure)" : "",
+            static_cast<unsigned long long>(total_size), elapsed,
+            total_size / elapsed * 1E-9);
+    if (source.NumMalformed() != 0) {
+      fprintf(stderr, "hwsum: WARNING: %llu lines are improperly formatted\n",
+              static_cast<unsigned long long>(source.NumMalformed()));
+    }
+  } else if (options.stats) {
+    // Small files are always read, so name the method used for most bytes.
+    const int io = std::max_element(io_sizes, io_sizes + 4) - io_sizes;
+    fprintf(stderr,
+            "hwsum: %llu files, %llu bytes in %.3f s = %.2f GB/s (%s, %d "
+            "threads)\n",
+            static_cast<unsigned long long>(num_files),
+            static_cast<unsigned long long>(total_size), elapsed,
+            total_size / elapsed * 1E-9, kIONames[io], options.num_threads);
+  }
+  if (list != nullptr && list != stdin) fclose(list);
+  const bool ok = num_unreadable == 0 && num_mismatched == 0 &&
+                  (manifest == nullptr || num_files != 0);
+  return ok ? 0 : 1;
 }
@@ -0,0 +1,106 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "instruction_sets.h"
+
+#include "code_annotation.h"
+
+#if MSC_VERSION
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+
+// Returns cpuid registers eax, ebx, ecx, edx for the given leaf.
+void Cpuid(const uint32_t level, const uint32_t count, uint32_t abcd[4]) {
+#if MSC_VERSION
+  int regs[4];
+  __cpuidex(regs, level, count);
+  for (int i = 0; i < 4; ++i) {
+    abcd[i] = regs[i];
+  }
+#else
+  __cpuid_count(level, count, abcd[0], abcd[1], abcd[2], abcd[3]);
+#endif
+}
+
+// Returns the extended control register XCR0, which indicates which
+// register states the OS saves on context switches.
+uint64_t ReadXCR0() {
+#if MSC_VERSION
+  return _xgetbv(0);
+#else
+  // Not _xgetbv, which requires compiling with -mxsave.
+  uint32_t lo, hi;
+  asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+
+bool IsBitSet(const uint32_t reg, const int bit) {
+  return (reg >> bit) & 1;
+}
+
+uint32_t DetectInstructionSets() {
+  uint32_t supported = 0;
+
+  uint32_t abcd[4];
+  Cpuid(0, 0, abcd);
+  const uint32_t max_level = abcd[0];
+  if (max_level < 1) {
+    return supported;
+  }
+
+  Cpuid(1, 0, abcd);
+  if (IsBitSet(abcd[2], 19)) {
+    supported |= InstructionSets::kSSE41;
+  }
+
+  // AVX2 and AVX-512 are reported by leaf 7, which some CPUs and hypervisors
+  // (or "Limit CPUID Maxval") hide even though leaf 1 reports SSE4.1.
+  if (max_level < 7) {
+    return supported;
+  }
+
+  const bool osxsave = IsBitSet(abcd[2], 27);
+  const bool avx = IsBitSet(abcd[2], 28);
+  // The OS must save the XMM and YMM registers.
+  if (!osxsave || !avx || (ReadXCR0() & 6) != 6) {
+    return supported;
+  }
+
+  Cpuid(7, 0, abcd);
+  if (IsBitSet(abcd[1], 5)) {
+    supported |= InstructionSets::kAVX2;
+  }
+
+  // AVX-512F and AVX-512BW; the OS must also save the opmask and ZMM
+  // registers.
+  const uint64_t xcr0 = ReadXCR0();
+  if (IsBitSet(abcd[1], 16) && IsBitSet(abcd[1], 30) &&
+      (xcr0 & 0xE6) == 0xE6 && (supported & InstructionSets::kAVX2)) {
+    supported |= InstructionSets::kAVX512;
+  }
+
+  return supported;
+}
+
+}  // namespace
+
+uint32_t InstructionSets::Supported() {
+  static const uint32_t supported = DetectInstructionSets();
+  return supported;
+}
@@ -0,0 +1,36 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_INSTRUCTION_SETS_H_
+#define HIGHWAYHASH_INSTRUCTION_SETS_H_
+
+#include <cstdint>
+
+// Detects which instruction sets the CPU supports, so that a single binary
+// can choose the fastest kernel at runtime (see dispatch.cc).
+class InstructionSets {
+ public:
+  // Bits returned by Supported().
+  static const uint32_t kAVX2 = 1;
+  // AVX-512 Foundation and Byte/Word instructions.
+  static const uint32_t kAVX512 = 2;
+  static const uint32_t kSSE41 = 4;
+
+  // Returns the union of the above bits for instruction sets that both the
+  // CPU and the OS (which must save the wider registers) support.
+  // Thread-safe; the CPU is only queried on the first call.
+  static uint32_t Supported();
+};
+
+#endif  // #ifndef HIGHWAYHASH_INSTRUCTION_SETS_H_
@@ -0,0 +1,52 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "parallel_highway_tree_hash512.h"
+
+#include <algorithm>
+#include <vector>
+#include "highway_tree_hash512.h"
+#include "thread_pool.h"
+
+void ParallelHighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                                const uint64_t size, ThreadPool* pool,
+                                uint64_t out[8]) {
+  const uint64_t num_leaves =
+      (size + kParallelLeafSize - 1) / kParallelLeafSize;
+
+  // Each leaf writes only its own digest, so the order in which the threads
+  // finish does not matter.
+  std::vector<uint64_t> digests(num_leaves * 8);
+  pool->Run(num_leaves, [&](const uint64_t leaf, const int thread) {
+    const uint64_t begin = leaf * kParallelLeafSize;
+    const uint64_t leaf_size = std::min(kParallelLeafSize, size - begin);
+    HighwayTreeHash512(key, bytes + begin, leaf_size, &digests[leaf * 8]);
+  });
+
+  // HighwayTreeHash512 only uses the first 256 bits of the key; flipping
+  // bits there ensures the root differs from a leaf with the same contents.
+  uint64_t root_key[8];
+  for (int i = 0; i < 8; ++i) {
+    root_key[i] = key[i] ^ 0xA5A5A5A5A5A5A5A5ULL;
+  }
+
+  HighwayTreeHashStream512 root(root_key);
+  root.Update(reinterpret_cast<const uint8_t*>(digests.data()),
+              digests.size() * sizeof(uint64_t));
+  uint8_t size_bytes[8];
+  for (int i = 0; i < 8; ++i) {
+    size_bytes[i] = static_cast<uint8_t>(size >> (i * 8));
+  }
+  root.Update(size_bytes, sizeof(size_bytes));
+  root.Finalize(out);
+}
@@ -0,0 +1,43 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_PARALLEL_HIGHWAY_TREE_HASH512_H_
+#define HIGHWAYHASH_PARALLEL_HIGHWAY_TREE_HASH512_H_
+
+#include <cstdint>
+
+class ThreadPool;
+
+// Size of the leaves of ParallelHighwayTreeHash512. Part of the definition
+// of the hash; changing it changes all results.
+static const uint64_t kParallelLeafSize = 1ULL << 20;
+
+// Tree mode of HighwayTreeHash512 for very large inputs, which hashes
+// 1 MiB leaves on all threads of "pool" and then combines their digests.
+// This is a different function than HighwayTreeHash512 (the results
+// differ), but they are equally strong. The result only depends on the
+// key and data, never on the number of threads or scheduling.
+//
+// Leaf i consists of the bytes [i * kParallelLeafSize, (i + 1) *
+// kParallelLeafSize) of the input (the last leaf may be shorter). Its digest
+// is HighwayTreeHash512(key, leaf). "out" is the HighwayTreeHash512 of the
+// concatenated leaf digests followed by the total size (8 bytes, little-
+// endian), using a key derived from "key" that separates it from leaves.
+//
+// "key" is a secret 512-bit key unknown to attackers.
+// "bytes" is the data to hash (possibly unaligned); "size" bytes are read.
+void ParallelHighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                                const uint64_t size, ThreadPool* pool,
+                                uint64_t out[8]);
+
+#endif  // #ifndef HIGHWAYHASH_PARALLEL_HIGHWAY_TREE_HASH512_H_
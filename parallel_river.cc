@@ -0,0 +1,38 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "parallel_river.h"
+
+#include <algorithm>
+#include "river.h"
+#include "thread_pool.h"
+
+void ParallelRiverFill(const uint64_t (&key)[8], const uint64_t offset,
+                       uint8_t* bytes, const size_t size, ThreadPool* pool) {
+  if (size == 0) return;
+  // Tasks are aligned to the stream (not "bytes") so that they begin at
+  // packet boundaries and only the first task has to seek within a segment.
+  const uint64_t first_task = offset / kParallelRiverTaskSize;
+  const uint64_t end = offset + size;
+  const uint64_t num_tasks =
+      (end + kParallelRiverTaskSize - 1) / kParallelRiverTaskSize - first_task;
+
+  pool->Run(num_tasks, [&](const uint64_t task, const int thread) {
+    const uint64_t task_begin = (first_task + task) * kParallelRiverTaskSize;
+    const uint64_t begin = std::max(offset, task_begin);
+    const uint64_t task_end =
+        std::min(end, task_begin + kParallelRiverTaskSize);
+    SeekableRiver river(key, nullptr, begin);
+    river.Fill(bytes + (begin - offset), task_end - begin);
+  });
+}
@@ -0,0 +1,35 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_PARALLEL_RIVER_H_
+#define HIGHWAYHASH_PARALLEL_RIVER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// Number of bytes generated by each task of ParallelRiverFill. Only affects
+// performance, not the output.
+static const uint64_t kParallelRiverTaskSize = 1ULL << 20;
+
+// Writes bytes [offset, offset + size) of the SeekableRiver stream for "key"
+// to "bytes", using all threads of "pool". The output is identical to
+// SeekableRiver::Seek(offset) followed by Fill, regardless of the number of
+// threads or scheduling. Large outputs can be generated in several calls by
+// advancing "offset"; independent substreams start at multiples of
+// SeekableRiver::kSubstreamSize.
+void ParallelRiverFill(const uint64_t (&key)[8], const uint64_t offset,
+                       uint8_t* bytes, const size_t size, ThreadPool* pool);
+
+#endif  // #ifndef HIGHWAYHASH_PARALLEL_RIVER_H_
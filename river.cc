@@ -14,18 +14,37 @@
 
 #include "river.h"
 
+#include <algorithm>
 #include <cstring>  // memcpy
 #include <stdio.h>
+#include "dispatch.h"
+#include "instruction_sets.h"
 #include "vec2.h"
 
 const int kBlockSize = 64;
 const int kPacketSize = 512;
 
+// Generator state: v0..v3 and mul0..mul3 are kept in registers while
+// generating packets. The packets (which are also part of the state) and the
+// saved registers reside in "words", which need not be aligned, so River
+// objects can be stored anywhere. Layout: 64 words of packets, then v0..v3
+// and mul0..mul3.
 class RiverImpl {
  public:
+  static const int kPacketWords = kPacketSize / sizeof(uint64_t);
+
+  explicit INLINE RiverImpl(uint64_t* words) : words_(words) {}
+
+  // Leaves the state unattached; call Attach before use.
+  INLINE RiverImpl() : words_(nullptr) {}
+
+  // Uses the state in "words" and restores the registers from it.
+  INLINE void Attach(uint64_t* words) {
+    words_ = words;
+    Restore();
+  }
+
   void Init(const uint64_t key[kBlockSize / sizeof(uint64_t)]) {
-    ALIGNED(uint64_t, 64) key_data[kBlockSize / sizeof(uint64_t)];
-    memcpy(key_data, key, kBlockSize);
     const V4x64U init0(0x243f6a8885a308d3ull, 0x13198a2e03707344ull,
         0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
     const V4x64U init1(0x452821e638d01377ull, 0xbe5466cf34e90c6cull,
@@ -41,6 +60,44 @@ class RiverImpl {
     mul1 = v1 + init1;
     mul2 = v2 + init0;
     mul3 = v3 + init1;
+    // The output of each packet is fed back into the next, so the initial
+    // packets must be defined.
+    memset(words_, 0, kPacketSize);
+  }
+
+  // Initializes the state for segment number "segment" of SeekableRiver.
+  void InitSegment(const uint64_t key[kBlockSize / sizeof(uint64_t)],
+                   const uint64_t nonce[2], const uint64_t segment) {
+    Init(key);
+    v2 ^= V4x64U(segment);
+    v3 ^= V4x64U(nonce[1], nonce[0], nonce[1], nonce[0]);
+    // Mixes the segment and nonce into all lanes; the output is discarded.
+    UpdatePacket();
+  }
+
+  // Loads/stores the registers from/to "words".
+  INLINE void Restore() {
+    const uint64_t* saved = words_ + kPacketWords;
+    v0 = LoadU(saved + 0);
+    v1 = LoadU(saved + 4);
+    v2 = LoadU(saved + 8);
+    v3 = LoadU(saved + 12);
+    mul0 = LoadU(saved + 16);
+    mul1 = LoadU(saved + 20);
+    mul2 = LoadU(saved + 24);
+    mul3 = LoadU(saved + 28);
+  }
+
+  INLINE void Save() const {
+    uint64_t* saved = words_ + kPacketWords;
+    StoreU(v0, saved + 0);
+    StoreU(v1, saved + 4);
+    StoreU(v2, saved + 8);
+    StoreU(v3, saved + 12);
+    StoreU(mul0, saved + 16);
+    StoreU(mul1, saved + 20);
+    StoreU(mul2, saved + 24);
+    StoreU(mul3, saved + 28);
   }
 
   inline void Update(V4x64U *out1, V4x64U *out2) {
@@ -87,25 +144,32 @@ class RiverImpl {
     return V4x64U(_mm256_shuffle_epi8(v, V4x64U(hi, lo, hi, lo)));
   }
 
+  // Updates each pair of 32-byte vectors of the packet in turn and also
+  // passes each output vector and its index to "output" while it is still
+  // in a register.
+  // Note: a second pass over the packet (8, 2, 12, 6, 0, 10, 4, 14) does not
+  // seem to be required.
+  template <class Output>
+  INLINE void UpdatePacket(const Output& output) {
+    for (int i = 0; i < 16; i += 2) {
+      UpdateVectors(i, output);
+    }
+  }
+
+  // Updates vectors i and i + 1 of the packet; one step of UpdatePacket.
+  template <class Output>
+  INLINE void UpdateVectors(const int i, const Output& output) {
+    V4x64U out1 = LoadU(words_ + i * 4);
+    V4x64U out2 = LoadU(words_ + i * 4 + 4);
+    Update(&out1, &out2);
+    StoreU(out1, words_ + i * 4);
+    StoreU(out2, words_ + i * 4 + 4);
+    output(out1, i);
+    output(out2, i + 1);
+  }
+
   INLINE void UpdatePacket() {
-    Update(packets + 0,  packets + 1);
-    Update(packets + 2,  packets + 3);
-    Update(packets + 4,  packets + 5);
-    Update(packets + 6,  packets + 7);
-    Update(packets + 8,  packets + 9);
-    Update(packets + 10, packets + 11);
-    Update(packets + 12, packets + 13);
-    Update(packets + 14, packets + 15);
-    /* These extra calls to Update do not seem to be required.
-    Update(packets + 8,  packets + 9);
-    Update(packets + 2,  packets + 3);
-    Update(packets + 12, packets + 13);
-    Update(packets + 6,  packets + 7);
-    Update(packets + 0,  packets + 1);
-    Update(packets + 10, packets + 11);
-    Update(packets + 4,  packets + 5);
-    Update(packets + 14, packets + 15);
-    */
+    UpdatePacket([](const V4x64U& v, const int i) {});
   }
 
   void print() {
@@ -115,12 +179,20 @@ class RiverImpl {
       v3.print("v3");
   }
 
-  // Returns pointer to uint64_ data[8] of pseudo-random data.
+  // Returns pointer to uint64_ data[64] of pseudo-random data.
   const uint64_t *GenerateData() {
      UpdatePacket();
-     return reinterpret_cast<const uint64_t*>(packets);
+     return words_;
   }
 
+  // Returns the most recent packet.
+  const uint64_t* Packet() const { return words_; }
+
+  // Returns the state (packets and saved registers).
+  uint64_t* Words() const { return words_; }
+
+ private:
+  uint64_t* words_;
   V4x64U v0;
   V4x64U v1;
   V4x64U v2;
@@ -129,17 +201,461 @@ class RiverImpl {
   V4x64U mul1;
   V4x64U mul2;
   V4x64U mul3;
-  V4x64U packets[16];
 };  // class RiverImpl
 
+namespace {
+
+// Fills of at least this many bytes (larger than typical L2 caches) use
+// non-temporal stores to avoid evicting the caller's working set.
+const size_t kStreamThreshold = 1 << 20;
+
+// Output functors for RiverImpl::UpdatePacket; "to" is the start of the
+// 512-byte packet and "i" the index of the 32-byte vector within it.
+struct StoreOutput {
+  INLINE void operator()(const V4x64U& v, const int i) const {
+    StoreU(v, to + i * 4);
+  }
+  uint64_t* to;
+};
+
+// "to" must be vector-aligned.
+struct StreamOutput {
+  INLINE void operator()(const V4x64U& v, const int i) const {
+    Stream(v, to + i * 4);
+  }
+  uint64_t* to;
+};
+
+struct XorOutput {
+  INLINE void operator()(const V4x64U& v, const int i) const {
+    StoreU(LoadU(to + i * 4) ^ v, to + i * 4);
+  }
+  uint64_t* to;
+};
+
+struct NoOutput {
+  INLINE void operator()(const V4x64U& v, const int i) const {}
+};
+
+// Packet kernels for one instruction set (see dispatch.h). "pair" kernels
+// advance two independent states at once and are null if unavailable.
+struct RiverKernels {
+  void (*copy)(uint64_t*, const uint64_t, uint8_t*, const bool);
+  void (*xor_packets)(uint64_t*, const uint64_t, uint8_t*);
+  void (*copy_pair)(uint64_t*, uint64_t*, const uint64_t, uint8_t*, uint8_t*,
+                    const bool);
+  void (*xor_pair)(uint64_t*, uint64_t*, const uint64_t, uint8_t*, uint8_t*);
+};
+
+const RiverKernels kAVX2Kernels = {AVX2RiverCopy, AVX2RiverXor, nullptr,
+                                   nullptr};
+
+// Single streams use the AVX-2 kernels even on AVX-512 CPUs; see the
+// comment at the top of avx512_river.cc.
+const RiverKernels kAVX512Kernels = {AVX2RiverCopy, AVX2RiverXor,
+                                     AVX512RiverCopy2, AVX512RiverXor2};
+
+const RiverKernels* ChooseKernels() {
+  if (InstructionSets::Supported() & InstructionSets::kAVX512) {
+    return &kAVX512Kernels;
+  }
+  return &kAVX2Kernels;
+}
+
+INLINE const RiverKernels& Kernels() {
+  static const RiverKernels* const kernels = ChooseKernels();
+  return *kernels;
+}
+
+// Policies for FillBytes: how to output partial and whole packets.
+struct Copy {
+  using Output = StoreOutput;
+
+  static void Partial(const uint8_t* from, const size_t size, uint8_t* to) {
+    memcpy(to, from, size);
+  }
+
+  static void Packets(uint64_t* state, const size_t num_packets,
+                      uint8_t* bytes, const bool large) {
+    Kernels().copy(state, num_packets, bytes, large);
+  }
+
+  static bool HasPair() { return Kernels().copy_pair != nullptr; }
+
+  static void Pair(uint64_t* state0, uint64_t* state1,
+                   const size_t num_packets, uint8_t* bytes0, uint8_t* bytes1,
+                   const bool large) {
+    Kernels().copy_pair(state0, state1, num_packets, bytes0, bytes1, large);
+  }
+};
+
+struct Xor {
+  using Output = XorOutput;
+
+  static void Partial(const uint8_t* from, const size_t size, uint8_t* to) {
+    for (size_t i = 0; i < size; ++i) {
+      to[i] ^= from[i];
+    }
+  }
+
+  static void Packets(uint64_t* state, const size_t num_packets,
+                      uint8_t* bytes, const bool large) {
+    Kernels().xor_packets(state, num_packets, bytes);
+  }
+
+  static bool HasPair() { return Kernels().xor_pair != nullptr; }
+
+  static void Pair(uint64_t* state0, uint64_t* state1,
+                   const size_t num_packets, uint8_t* bytes0, uint8_t* bytes1,
+                   const bool large) {
+    Kernels().xor_pair(state0, state1, num_packets, bytes0, bytes1);
+  }
+};
+
+// Outputs the next "size" bytes of the stream; "remaining" is the number of
+// unused bytes at the end of impl->packets. "large" indicates this is part of
+// a fill of at least kStreamThreshold bytes.
+template <class Policy>
+void FillBytes(RiverImpl* impl, uint32_t* remaining, uint8_t* bytes,
+               size_t size, const bool large) {
+  const uint8_t* packet = reinterpret_cast<const uint8_t*>(impl->Packet());
+
+  // Leftover bytes from the previous packet.
+  const size_t head = std::min<size_t>(size, *remaining);
+  Policy::Partial(packet + kPacketSize - *remaining, head, bytes);
+  *remaining -= head;
+  bytes += head;
+  size -= head;
+
+  // Whole packets are written directly from registers.
+  const size_t num_packets = size / kPacketSize;
+  if (num_packets != 0) {
+    impl->Save();
+    Policy::Packets(impl->Words(), num_packets, bytes, large);
+    impl->Restore();
+  }
+  bytes += num_packets * kPacketSize;
+  size -= num_packets * kPacketSize;
+
+  // Start of a new packet; the rest is returned by the next call.
+  if (size != 0) {
+    impl->GenerateData();
+    Policy::Partial(packet, size, bytes);
+    *remaining = kPacketSize - size;
+  }
+}
+
+// Generates the next packet of each of the N instances, one pair of vectors
+// of each at a time: their Update chains are independent, so the CPU can
+// overlap their multiplication and shuffle latencies.
+template <int N, class Output>
+INLINE void UpdateInterleaved(RiverImpl* impls, const Output* outputs) {
+  for (int i = 0; i < 16; i += 2) {
+    for (int k = 0; k < N; ++k) {
+      impls[k].UpdateVectors(i, outputs[k]);
+    }
+  }
+}
+
+// Advances the N "states" by "num_packets" packets. The first "num_output"
+// packets of states[k] are passed to outputs[k], the others (at most one, a
+// partially used packet) only update the state.
+template <int N, class Output>
+void InterleavedPackets(uint64_t* const* states, const size_t num_packets,
+                        const size_t num_output, Output* outputs) {
+  RiverImpl impls[N];
+  for (int k = 0; k < N; ++k) {
+    impls[k].Attach(states[k]);
+  }
+  for (size_t p = 0; p < num_output; ++p) {
+    UpdateInterleaved<N>(impls, outputs);
+    for (int k = 0; k < N; ++k) {
+      outputs[k].to += kPacketSize / sizeof(uint64_t);
+    }
+  }
+  const NoOutput none[N] = {};
+  for (size_t p = num_output; p < num_packets; ++p) {
+    UpdateInterleaved<N>(impls, none);
+  }
+  for (int k = 0; k < N; ++k) {
+    impls[k].Save();
+  }
+}
+
+}  // namespace
+
+void AVX2RiverCopy(uint64_t* state, const uint64_t num_packets,
+                   uint8_t* bytes, const bool stream) {
+  RiverImpl impl(state);
+  impl.Restore();
+  uint64_t* to = reinterpret_cast<uint64_t*>(bytes);
+  if (stream && reinterpret_cast<uintptr_t>(bytes) % sizeof(V4x64U) == 0) {
+    for (uint64_t i = 0; i < num_packets; ++i) {
+      impl.UpdatePacket(StreamOutput{to + i * kPacketSize / 8});
+    }
+    _mm_sfence();
+  } else {
+    for (uint64_t i = 0; i < num_packets; ++i) {
+      impl.UpdatePacket(StoreOutput{to + i * kPacketSize / 8});
+    }
+  }
+  impl.Save();
+}
+
+void AVX2RiverXor(uint64_t* state, const uint64_t num_packets,
+                  uint8_t* bytes) {
+  RiverImpl impl(state);
+  impl.Restore();
+  uint64_t* to = reinterpret_cast<uint64_t*>(bytes);
+  for (uint64_t i = 0; i < num_packets; ++i) {
+    impl.UpdatePacket(XorOutput{to + i * kPacketSize / 8});
+  }
+  impl.Save();
+}
+
 // Create a river object for generating a cryptogrpahic stream of
 // pseudo-random data for use in a stream cipher.
-River::River(const uint64_t key[kBlockSize / sizeof(uint64_t)]) {
-  river_impl_ = reinterpret_cast<RiverImpl *>(buffer_);
-  river_impl_->Init(key);
+River::River(const uint64_t key[kBlockSize / sizeof(uint64_t)])
+    : remaining_(0) {
+  RiverImpl impl(state_);
+  impl.Init(key);
+  impl.Save();
 }
 
 // Generate 64 uint64's worth (512 bytes) of cryptograpic pseudo-random data.
 const uint64_t *River::GeneratePseudoRandomData() {
-  return river_impl_->GenerateData();
+  remaining_ = 0;
+  RiverImpl impl(state_);
+  impl.Restore();
+  impl.GenerateData();
+  impl.Save();
+  return state_;
+}
+
+void River::Fill(uint8_t* bytes, const size_t size) {
+  RiverImpl impl(state_);
+  impl.Restore();
+  FillBytes<Copy>(&impl, &remaining_, bytes, size, size >= kStreamThreshold);
+  impl.Save();
+}
+
+void River::FillXor(uint8_t* bytes, const size_t size) {
+  RiverImpl impl(state_);
+  impl.Restore();
+  FillBytes<Xor>(&impl, &remaining_, bytes, size, false);
+  impl.Save();
+}
+
+River River::Fork() {
+  // The first kBlockSize bytes of the packet serve as the key.
+  return River(GeneratePseudoRandomData());
+}
+
+void RiverEngine::Refill() {
+  river_.GeneratePseudoRandomData();
+  next_ = 0;
+}
+
+void RiverEngine::discard(unsigned long long num) {
+  const uint32_t buffered = std::min<unsigned long long>(
+      num, kWordsPerPacket - next_);
+  next_ += buffered;
+  num -= buffered;
+  for (; num >= kWordsPerPacket; num -= kWordsPerPacket) {
+    river_.GeneratePseudoRandomData();
+  }
+  if (num != 0) {
+    Refill();
+    next_ = num;
+  }
+}
+
+void RiverEngine::Generate(uint64_t* words, size_t num) {
+  const uint32_t buffered = std::min<size_t>(num, kWordsPerPacket - next_);
+  if (buffered != 0) {
+    memcpy(words, river_.Packet() + next_, buffered * sizeof(uint64_t));
+    next_ += buffered;
+    words += buffered;
+    num -= buffered;
+  }
+
+  // All buffered words are used, so River::Fill starts at the next packet.
+  const size_t num_packets = num / kWordsPerPacket;
+  river_.Fill(reinterpret_cast<uint8_t*>(words),
+              num_packets * River::kPacketSize);
+  words += num_packets * kWordsPerPacket;
+  num -= num_packets * kWordsPerPacket;
+
+  for (size_t i = 0; i < num; ++i) {
+    words[i] = (*this)();
+  }
+}
+
+SeekableRiver::SeekableRiver(
+    const uint64_t key[River::kBlockSize / sizeof(uint64_t)],
+    const uint64_t nonce[2], const uint64_t offset) {
+  memcpy(key_, key, sizeof(key_));
+  nonce_[0] = nonce == nullptr ? 0 : nonce[0];
+  nonce_[1] = nonce == nullptr ? 0 : nonce[1];
+  Seek(offset);
+}
+
+void SeekableRiver::Seek(const uint64_t offset) {
+  RiverImpl impl(state_);
+  const uint64_t segment = offset / kSegmentSize;
+  impl.InitSegment(key_, nonce_, segment);
+  segment_end_ = (segment + 1) * kSegmentSize;
+  position_ = offset;
+  remaining_ = 0;
+
+  const uint64_t offset_in_segment = offset % kSegmentSize;
+  for (uint64_t i = 0; i < offset_in_segment / kPacketSize; ++i) {
+    impl.GenerateData();
+  }
+  if (offset_in_segment % kPacketSize != 0) {
+    impl.GenerateData();
+    remaining_ = kPacketSize - offset_in_segment % kPacketSize;
+  }
+  impl.Save();
+}
+
+template <class Policy>
+void SeekableRiver::FillSegments(uint8_t* bytes, size_t size) {
+  RiverImpl impl(state_);
+  impl.Restore();
+  const bool large = size >= kStreamThreshold;
+  const uint32_t kSegmentPackets = kSegmentSize / kPacketSize;
+  while (size != 0) {
+    // Whole segments are independent, so generate two at a time if possible.
+    if (position_ % kSegmentSize == 0 && size >= 2 * kSegmentSize &&
+        Policy::HasPair()) {
+      const uint64_t segment = position_ / kSegmentSize;
+      uint64_t state0[River::kStateWords];
+      RiverImpl impl0(state0);
+      impl0.InitSegment(key_, nonce_, segment);
+      impl0.Save();
+      impl.InitSegment(key_, nonce_, segment + 1);
+      impl.Save();
+      Policy::Pair(state0, state_, kSegmentPackets, bytes,
+                   bytes + kSegmentSize, large);
+      impl.Restore();
+      position_ += 2 * kSegmentSize;
+      segment_end_ = position_;
+      remaining_ = 0;
+      bytes += 2 * kSegmentSize;
+      size -= 2 * kSegmentSize;
+      continue;
+    }
+    if (position_ == segment_end_) {
+      impl.InitSegment(key_, nonce_, position_ / kSegmentSize);
+      segment_end_ += kSegmentSize;
+    }
+    const size_t bytes_in_segment =
+        std::min<uint64_t>(size, segment_end_ - position_);
+    FillBytes<Policy>(&impl, &remaining_, bytes, bytes_in_segment, large);
+    position_ += bytes_in_segment;
+    bytes += bytes_in_segment;
+    size -= bytes_in_segment;
+  }
+  impl.Save();
+}
+
+void SeekableRiver::Fill(uint8_t* bytes, const size_t size) {
+  FillSegments<Copy>(bytes, size);
+}
+
+void SeekableRiver::FillXor(uint8_t* bytes, const size_t size) {
+  FillSegments<Xor>(bytes, size);
+}
+
+MultiRiver::MultiRiver(const uint64_t* const keys[], const size_t num)
+    : num_(num) {
+  // Init only depends on the key; doing all instances in one loop lets the
+  // CPU overlap them.
+  for (size_t k = 0; k < num_; ++k) {
+    RiverImpl impl(rivers_[k].state_);
+    impl.Init(keys[k]);
+    impl.Save();
+    rivers_[k].remaining_ = 0;
+  }
+}
+
+template <class Policy>
+void MultiRiver::FillAll(uint8_t* const bytes[], const size_t size) {
+  const uint32_t remaining = rivers_[0].remaining_;
+  bool lockstep = true;
+  for (size_t k = 1; k < num_; ++k) {
+    lockstep &= rivers_[k].remaining_ == remaining;
+  }
+  // Instances that were used separately are filled separately.
+  if (!lockstep) {
+    for (size_t k = 0; k < num_; ++k) {
+      RiverImpl impl(rivers_[k].state_);
+      impl.Restore();
+      FillBytes<Policy>(&impl, &rivers_[k].remaining_, bytes[k], size,
+                        false);
+      impl.Save();
+    }
+    return;
+  }
+
+  // Same steps as FillBytes, for all instances at once.
+  const size_t head = std::min<size_t>(size, remaining);
+  const size_t num_output = (size - head) / kPacketSize;
+  const size_t tail = (size - head) % kPacketSize;
+  uint64_t* states[kMaxInstances];
+  typename Policy::Output outputs[kMaxInstances];
+  for (size_t k = 0; k < num_; ++k) {
+    const uint8_t* packet =
+        reinterpret_cast<const uint8_t*>(rivers_[k].state_);
+    Policy::Partial(packet + kPacketSize - remaining, head, bytes[k]);
+    states[k] = rivers_[k].state_;
+    outputs[k].to = reinterpret_cast<uint64_t*>(bytes[k] + head);
+  }
+
+  // Instances are generated in pairs, with the two-state kernel if
+  // available (AVX-512). Interleaving more than two was slower because
+  // their registers no longer fit.
+  const size_t num_packets = num_output + (tail != 0);
+  size_t k = 0;
+  for (; k + 1 < num_; k += 2) {
+    if (Policy::HasPair()) {
+      if (num_output != 0) {
+        Policy::Pair(states[k], states[k + 1], num_output,
+                     reinterpret_cast<uint8_t*>(outputs[k].to),
+                     reinterpret_cast<uint8_t*>(outputs[k + 1].to), false);
+      }
+      if (tail != 0) {
+        // Only updates the states; their packets are copied below.
+        uint8_t unused[2][kPacketSize];
+        Kernels().copy_pair(states[k], states[k + 1], 1, unused[0],
+                            unused[1], false);
+      }
+    } else {
+      InterleavedPackets<2>(states + k, num_packets, num_output, outputs + k);
+    }
+  }
+  if (k < num_) {
+    InterleavedPackets<1>(states + k, num_packets, num_output, outputs + k);
+  }
+
+  for (size_t k = 0; k < num_; ++k) {
+    if (tail != 0) {
+      const uint8_t* packet =
+          reinterpret_cast<const uint8_t*>(rivers_[k].state_);
+      Policy::Partial(packet, tail,
+                      bytes[k] + head + num_output * kPacketSize);
+      rivers_[k].remaining_ = kPacketSize - tail;
+    } else {
+      rivers_[k].remaining_ = remaining - head;
+    }
+  }
+}
+
+void MultiRiver::Fill(uint8_t* const bytes[], const size_t size) {
+  FillAll<Copy>(bytes, size);
+}
+
+void MultiRiver::FillXor(uint8_t* const bytes[], const size_t size) {
+  FillAll<Xor>(bytes, size);
 }
@@ -15,26 +15,198 @@
 #ifndef HIGHWAYHASH_RIVER_H_
 #define HIGHWAYHASH_RIVER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include "code_annotation.h"
 
 class RiverImpl;
 
+// River objects are small (776 bytes), need no special alignment and may be
+// copied or moved; a copy continues with the same stream as the original.
 class River {
  public:
   static const uint32_t kBlockSize = 64;
   static const uint32_t kPacketSize = 512;
+  // Size of the generator state in uint64_t, including the current packet.
+  static const uint32_t kStateWords = 96;
+
+  // Returns whether the CPU supports River, which requires AVX-2; on other
+  // CPUs, all River classes would fault with an illegal instruction.
+  static bool Supported();
 
   // Create a river object for generating a cryptogrpahic stream of
   // pseudo-random data for use in a stream cipher.
   River(const uint64_t key[kBlockSize / sizeof(uint64_t)]);
 
   // Generate 64 uint64's worth (512 bytes) of cryptograpic pseudo-random data.
+  // Discards any bytes left over from a previous Fill/FillXor.
   const uint64_t *GeneratePseudoRandomData();
 
+  // Writes the next "size" bytes of the stream to "bytes", which need not be
+  // aligned. The stream is the concatenation of GeneratePseudoRandomData
+  // packets; the remainder of a partially used packet is returned by the
+  // next call. Large fills bypass the cache if "bytes" is suitably aligned.
+  void Fill(uint8_t* bytes, size_t size);
+
+  // As above, but XORs the stream into "bytes" (e.g. for encryption).
+  void FillXor(uint8_t* bytes, size_t size);
+
+  // Returns the packet most recently returned by GeneratePseudoRandomData.
+  const uint64_t* Packet() const { return state_; }
+
+  // Returns a River whose stream is independent of this one's, keyed by
+  // this River's next packet (which is consumed). Useful for giving each
+  // task or session its own River without managing keys.
+  River Fork();
+
+ private:
+  friend class MultiRiver;
+
+  // Leaves the state uninitialized; only for MultiRiver.
+  River() {}
+
+  // RiverImpl state; the current packet is at the beginning.
+  uint64_t state_[kStateWords];
+  // Number of unused bytes at the end of the most recent packet.
+  uint32_t remaining_;
+};
+
+// Up to kMaxInstances independent Rivers, e.g. one per new connection, that
+// are generated together. A single River is limited by the latency of its
+// Update dependency chain; interleaving the chains of several instances in
+// one thread hides it, which mainly helps short streams. Instance k outputs
+// exactly the stream of River(keys[k]).
+class MultiRiver {
+ public:
+  static const size_t kMaxInstances = 4;
+
+  // Initializes "num" (1 to kMaxInstances) instances with keys[0, num).
+  MultiRiver(const uint64_t* const keys[], size_t num);
+
+  // Writes the next "size" bytes of each instance's stream to bytes[k],
+  // same as River::Fill. Fastest if all instances are at the same position,
+  // i.e. not used separately since the last call.
+  void Fill(uint8_t* const bytes[], size_t size);
+
+  // As above, but XORs each stream into bytes[k].
+  void FillXor(uint8_t* const bytes[], size_t size);
+
+  size_t NumInstances() const { return num_; }
+
+  // Returns instance "k", e.g. to continue (or copy) its stream separately.
+  River& Instance(const size_t k) { return rivers_[k]; }
+  const River& Instance(const size_t k) const { return rivers_[k]; }
+
+ private:
+  template <class Policy>
+  void FillAll(uint8_t* const bytes[], size_t size);
+
+  River rivers_[kMaxInstances];
+  size_t num_;
+};
+
+// C++11 UniformRandomBitGenerator for <random> distributions and
+// std::shuffle. Returns the words of consecutive River packets.
+class RiverEngine {
+ public:
+  using result_type = uint64_t;
+
+  explicit RiverEngine(const uint64_t key[River::kBlockSize / sizeof(uint64_t)])
+      : river_(key), next_(kWordsPerPacket) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type(0); }
+
+  INLINE result_type operator()() {
+    if (next_ == kWordsPerPacket) Refill();
+    return river_.Packet()[next_++];
+  }
+
+  // Skips the next "num" words as if operator() were called "num" times.
+  void discard(unsigned long long num);
+
+  // Same as calling operator() "num" times, but faster for large "num".
+  void Generate(uint64_t* words, size_t num);
+
+ private:
+  static const uint32_t kWordsPerPacket = River::kPacketSize / sizeof(uint64_t);
+
+  void Refill();
+
+  River river_;
+  // Index of the next unused word of river_.Packet().
+  uint32_t next_;
+};
+
+// Random-access variant of River, e.g. for decrypting any range of a large
+// file, or in parallel. The stream is divided into segments of kSegmentSize
+// bytes, each generated by a River-like state initialized from the key and
+// the segment index. Seek therefore costs at most one segment (128 packets).
+// The output differs from River's.
+class SeekableRiver {
+ public:
+  static const uint32_t kSegmentSize = 64 * 1024;
+
+  // The stream is long enough to be split into 65536 non-overlapping
+  // substreams starting at multiples of this size, e.g. one per thread or
+  // simulation run. Seek(i * kSubstreamSize) starts substream i.
+  static const uint64_t kSubstreamSize = 1ULL << 48;
+
+  // Different (e.g. random or counter) "nonce" values yield independent
+  // streams for the same key. The default is {0, 0}. Output starts at byte
+  // "offset", which is cheaper than a subsequent Seek.
+  SeekableRiver(const uint64_t key[River::kBlockSize / sizeof(uint64_t)],
+                const uint64_t nonce[2] = nullptr, uint64_t offset = 0);
+
+  // Subsequent output starts at byte "offset" of the stream.
+  void Seek(uint64_t offset);
+
+  // Returns the offset of the next byte to be output.
+  uint64_t Position() const { return position_; }
+
+  // Same as River::Fill/FillXor.
+  void Fill(uint8_t* bytes, size_t size);
+  void FillXor(uint8_t* bytes, size_t size);
+
+ private:
+  template <class Policy>
+  void FillSegments(uint8_t* bytes, size_t size);
+
+  uint64_t key_[River::kBlockSize / sizeof(uint64_t)];
+  uint64_t nonce_[2];
+  uint64_t position_;
+  // Start of the segment after the one held in state_.
+  uint64_t segment_end_;
+  uint32_t remaining_;
+  // RiverImpl state; it has no pointers, so this class is copyable.
+  uint64_t state_[River::kStateWords];
+};
+
+// Stream cipher: XORs the SeekableRiver stream into data, in place. The
+// keystream is combined with the data as it is generated rather than being
+// written to memory first. Decryption is the same operation, so Crypt
+// serves for both. Each message encrypted with a key must use a unique
+// nonce; it need not be secret and is typically sent with the message.
+class RiverCipher {
+ public:
+  RiverCipher(const uint64_t key[River::kBlockSize / sizeof(uint64_t)],
+              const uint64_t nonce[2])
+      : river_(key, nonce) {}
+
+  // Encrypts or decrypts the next "size" bytes of the message. A message
+  // can be processed in any number of calls of any size.
+  void Crypt(uint8_t* bytes, const size_t size) {
+    river_.FillXor(bytes, size);
+  }
+
+  // Subsequent Crypt calls process the message starting at byte "offset",
+  // e.g. to decrypt only part of a file.
+  void Seek(const uint64_t offset) { river_.Seek(offset); }
+
+  uint64_t Position() const { return river_.Position(); }
+
  private:
-  RiverImpl* river_impl_;
-  ALIGNED(uint64_t, 64) buffer_[kPacketSize + 16*32 + 64];
+  SeekableRiver river_;
 };
 
 #endif  // #ifndef HIGHWAYHASH_RIVER_H_
@@ -0,0 +1,298 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "river_distributions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>  // memmove
+#include "river.h"
+#include "vec2.h"
+
+namespace {
+
+// Buffers River output so that vectors and individual words can be taken
+// from L1 without calling River for each.
+class RandomWords {
+ public:
+  static const size_t kBufferWords = 512;
+
+  explicit RandomWords(River* river) : river_(river), pos_(kBufferWords) {}
+
+  // Returns "num" <= kBufferWords consecutive unused (unaligned) words.
+  INLINE const uint64_t* Take(const size_t num) {
+    if (pos_ + num > kBufferWords) Refill();
+    const uint64_t* words = buffer_ + pos_;
+    pos_ += num;
+    return words;
+  }
+
+  INLINE uint64_t Next() { return *Take(1); }
+
+ private:
+  void Refill() {
+    const size_t unused = kBufferWords - pos_;
+    memmove(buffer_, buffer_ + pos_, unused * sizeof(uint64_t));
+    river_->Fill(reinterpret_cast<uint8_t*>(buffer_ + unused),
+                 (kBufferWords - unused) * sizeof(uint64_t));
+    pos_ = 0;
+  }
+
+  River* river_;
+  size_t pos_;
+  ALIGNED(uint64_t, 64) buffer_[kBufferWords];
+};
+
+// Converts the upper 52 bits to a double in [1, 2) by supplying the exponent.
+INLINE double ToDouble12(const uint64_t bits) {
+  const uint64_t double_bits = (bits >> 12) | 0x3FF0000000000000ULL;
+  double d;
+  memcpy(&d, &double_bits, sizeof(d));
+  return d;
+}
+
+INLINE __m256d ToDouble12(const V4x64U& bits) {
+  return _mm256_castsi256_pd(bits >> 12 | V4x64U(0x3FF0000000000000ULL));
+}
+
+INLINE float ToFloat9(const uint32_t bits) {
+  const uint32_t float_bits = (bits >> 9) | 0x3F800000u;
+  float f;
+  memcpy(&f, &float_bits, sizeof(f));
+  return f;
+}
+
+// Scalar Lemire step: stores a value in [0, bound) and returns true, or
+// returns false if "bits" must be rejected to avoid bias.
+INLINE bool Bounded(const uint32_t bits, const uint32_t bound,
+                    uint32_t* RESTRICT out) {
+  const uint64_t product = static_cast<uint64_t>(bits) * bound;
+  const uint32_t low = static_cast<uint32_t>(product);
+  if (low < bound && low < (0u - bound) % bound) return false;
+  *out = static_cast<uint32_t>(product >> 32);
+  return true;
+}
+
+// Ziggurat of 256 layers of equal area under the (unnormalized) normal
+// density f(x) = exp(-x^2 / 2). Layer i spans [0, x[i]) horizontally; points
+// with |x| < x[i + 1] are always under the curve. Layer 0 is the base strip
+// plus the tail beyond x[1] = r.
+struct Ziggurat {
+  static const int kLayers = 256;
+
+  Ziggurat() {
+    const double r = 3.6541528853610088;  // Marsaglia and Tsang (2000)
+    const double area = 0.00492867323399;
+    x[0] = area / Density(r);
+    x[1] = r;
+    for (int i = 2; i < kLayers; ++i) {
+      x[i] = std::sqrt(-2.0 * std::log(area / x[i - 1] + Density(x[i - 1])));
+    }
+    x[kLayers] = 0.0;
+    for (int i = 0; i <= kLayers; ++i) {
+      f[i] = Density(x[i]);
+    }
+  }
+
+  static double Density(const double x) { return std::exp(-0.5 * x * x); }
+
+  static const Ziggurat& Get() {
+    static const Ziggurat ziggurat;
+    return ziggurat;
+  }
+
+  double x[kLayers + 1];
+  double f[kLayers + 1];
+};
+
+// Returns a normal deviate from "bits" (the low 8 select the layer, the
+// upper 52 a position within it), drawing further words from "words" in the
+// rare case that the position is rejected or falls in the tail.
+double Normal(const Ziggurat& z, RandomWords* words, uint64_t bits) {
+  for (;;) {
+    const int i = bits & (Ziggurat::kLayers - 1);
+    const double u = 2.0 * ToDouble12(bits) - 3.0;  // [-1, 1)
+    const double x = u * z.x[i];
+    if (std::abs(x) < z.x[i + 1]) return x;
+
+    if (i == 0) {
+      // Tail beyond r (Marsaglia, 1964). The uniforms must not be zero.
+      const double r = z.x[1];
+      const double kScale = 1.0 / (1ULL << 53);
+      for (;;) {
+        const double u1 = ((words->Next() >> 11) + 1) * kScale;
+        const double u2 = ((words->Next() >> 11) + 1) * kScale;
+        const double tail_x = std::log(u1) / r;
+        const double tail_y = std::log(u2);
+        if (-2.0 * tail_y >= tail_x * tail_x) {
+          return u < 0.0 ? tail_x - r : r - tail_x;
+        }
+      }
+    }
+
+    // Between the inner rectangle and the curve.
+    const double uniform = ToDouble12(words->Next()) - 1.0;
+    if (z.f[i + 1] + (z.f[i] - z.f[i + 1]) * uniform < Ziggurat::Density(x)) {
+      return x;
+    }
+    bits = words->Next();
+  }
+}
+
+}  // namespace
+
+void FillUniform(River* river, double* out, const size_t num) {
+  RandomWords words(river);
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= num; i += 4) {
+    const V4x64U bits = LoadU(words.Take(4));
+    _mm256_storeu_pd(out + i, _mm256_sub_pd(ToDouble12(bits), one));
+  }
+  for (; i < num; ++i) {
+    out[i] = ToDouble12(words.Next()) - 1.0;
+  }
+}
+
+void FillUniform(River* river, float* out, const size_t num) {
+  RandomWords words(river);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256i exponent = _mm256_set1_epi32(0x3F800000);
+  size_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    const V4x64U bits = LoadU(words.Take(4));
+    const __m256i float_bits =
+        _mm256_or_si256(_mm256_srli_epi32(bits, 9), exponent);
+    _mm256_storeu_ps(out + i,
+                     _mm256_sub_ps(_mm256_castsi256_ps(float_bits), one));
+  }
+  for (; i < num; ++i) {
+    out[i] = ToFloat9(static_cast<uint32_t>(words.Next())) - 1.0f;
+  }
+}
+
+void FillBounded(River* river, const uint32_t bound, uint32_t* out,
+                 const size_t num) {
+  RandomWords words(river);
+  const V4x64U bound64(bound);
+  const __m256i bound32 = _mm256_set1_epi32(bound);
+  // For unsigned comparisons via signed compare instructions.
+  const __m256i sign = _mm256_set1_epi32(0x80000000);
+  const __m256i bound_signed = _mm256_xor_si256(bound32, sign);
+
+  size_t i = 0;
+  while (i + 8 <= num) {
+    // 8 uint32_t: the products of even lanes are in "even", odd in "odd".
+    const uint64_t* from = words.Take(4);
+    const V4x64U bits = LoadU(from);
+    const V4x64U even(_mm256_mul_epu32(bits, bound64));
+    const V4x64U odd(_mm256_mul_epu32(bits >> 32, bound64));
+    const __m256i low = _mm256_blend_epi32(even, odd << 32, 0xAA);
+    // Rejection is only possible if low < bound, which is rare unless bound
+    // is large. Then let the scalar code decide, one lane at a time.
+    const __m256i maybe_reject =
+        _mm256_cmpgt_epi32(bound_signed, _mm256_xor_si256(low, sign));
+    if (_mm256_testz_si256(maybe_reject, maybe_reject)) {
+      const __m256i high = _mm256_blend_epi32(even >> 32, odd, 0xAA);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), high);
+      i += 8;
+    } else {
+      const uint32_t* bits32 = reinterpret_cast<const uint32_t*>(from);
+      for (int lane = 0; lane < 8; ++lane) {
+        i += Bounded(bits32[lane], bound, out + i);
+      }
+    }
+  }
+  while (i < num) {
+    const uint64_t bits = words.Next();
+    i += Bounded(static_cast<uint32_t>(bits), bound, out + i);
+    if (i < num) {
+      i += Bounded(static_cast<uint32_t>(bits >> 32), bound, out + i);
+    }
+  }
+}
+
+void FillBernoulli(River* river, const double p, uint64_t* masks,
+                   const size_t num_masks) {
+  const double clamped = std::min(std::max(p, 0.0), 1.0);
+  const uint64_t threshold =
+      static_cast<uint64_t>(clamped * 4294967296.0 + 0.5);  // 0..2^32
+  if (threshold == 0 || threshold == (1ULL << 32)) {
+    std::fill(masks, masks + num_masks, threshold == 0 ? 0 : ~0ULL);
+    return;
+  }
+
+  // Each bit is 1 with probability threshold / 2^32 = 0.b31 b30 .. b0.
+  // Starting from the lowest set binary digit (probability 1/2), each
+  // subsequent digit halves the probability and adds 1/2 if it is set.
+  const int lowest = __builtin_ctzll(threshold);
+  RandomWords words(river);
+  size_t i = 0;
+  for (; i + 4 <= num_masks; i += 4) {
+    V4x64U mask = LoadU(words.Take(4));
+    for (int digit = lowest + 1; digit < 32; ++digit) {
+      const V4x64U bits = LoadU(words.Take(4));
+      if ((threshold >> digit) & 1) {
+        mask |= bits;
+      } else {
+        mask &= bits;
+      }
+    }
+    StoreU(mask, masks + i);
+  }
+  for (; i < num_masks; ++i) {
+    uint64_t mask = words.Next();
+    for (int digit = lowest + 1; digit < 32; ++digit) {
+      const uint64_t bits = words.Next();
+      mask = ((threshold >> digit) & 1) ? (mask | bits) : (mask & bits);
+    }
+    masks[i] = mask;
+  }
+}
+
+void FillNormal(River* river, double* out, const size_t num) {
+  const Ziggurat& z = Ziggurat::Get();
+  RandomWords words(river);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d three = _mm256_set1_pd(3.0);
+  const V4x64U layer_mask(Ziggurat::kLayers - 1);
+
+  size_t i = 0;
+  for (; i + 4 <= num; i += 4) {
+    const uint64_t* from = words.Take(4);
+    const V4x64U bits = LoadU(from);
+    const V4x64U layer = bits & layer_mask;
+    const __m256d outer = _mm256_i64gather_pd(z.x, layer, 8);
+    const __m256d inner = _mm256_i64gather_pd(z.x + 1, layer, 8);
+    const __m256d u =
+        _mm256_sub_pd(_mm256_mul_pd(two, ToDouble12(bits)), three);
+    const __m256d x = _mm256_mul_pd(u, outer);
+    const __m256d accept =
+        _mm256_cmp_pd(_mm256_andnot_pd(sign, x), inner, _CMP_LT_OQ);
+    if (_mm256_movemask_pd(accept) == 0xF) {
+      _mm256_storeu_pd(out + i, x);
+    } else {
+      // About 1% of vectors; recomputes the accepted lanes identically.
+      // Copies "from" because Normal may refill the buffer.
+      uint64_t lanes[4];
+      memcpy(lanes, from, sizeof(lanes));
+      for (int lane = 0; lane < 4; ++lane) {
+        out[i + lane] = Normal(z, &words, lanes[lane]);
+      }
+    }
+  }
+  for (; i < num; ++i) {
+    out[i] = Normal(z, &words, words.Next());
+  }
+}
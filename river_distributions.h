@@ -0,0 +1,45 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_RIVER_DISTRIBUTIONS_H_
+#define HIGHWAYHASH_RIVER_DISTRIBUTIONS_H_
+
+// Vectorized generators that fill arrays with random numbers of common
+// distributions, converting River output with AVX-2 instead of one value at
+// a time. The results are deterministic for a given River state, but each
+// call consumes an unspecified number of bytes of the River stream.
+
+#include <cstddef>
+#include <cstdint>
+
+class River;
+
+// Uniform in [0, 1), with 52 or 23 random mantissa bits.
+void FillUniform(River* river, double* out, size_t num);
+void FillUniform(River* river, float* out, size_t num);
+
+// Unbiased uniform integers in [0, bound), using Lemire's multiply-and-reject
+// method ("Fast Random Integer Generation in an Interval", 2019).
+// "bound" must be nonzero.
+void FillBounded(River* river, uint32_t bound, uint32_t* out, size_t num);
+
+// Sets each bit of "masks" independently with probability "p", which is
+// rounded to a multiple of 2^-32. Costs one River word per 64 bits and
+// significant binary digit of p, e.g. one for 0.5 and two for 0.25 or 0.75.
+void FillBernoulli(River* river, double p, uint64_t* masks, size_t num_masks);
+
+// Standard normal deviates (mean 0, standard deviation 1), using a
+// 256-layer ziggurat (Marsaglia and Tsang, 2000).
+void FillNormal(River* river, double* out, size_t num);
+
+#endif  // #ifndef HIGHWAYHASH_RIVER_DISTRIBUTIONS_H_
@@ -12,22 +12,170 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Writes the SeekableRiver stream to stdout, e.g. for randomness test
+// batteries or filling disks. Usage:
+//   river [--bytes N[K|M|G|T]] [--threads N] [--key HEX | --seed N] [--quiet]
+// The output only depends on the key, never on the number of threads.
+// Throughput is reported to stderr.
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <vector>
+#include "parallel_river.h"
 #include "river.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Output is generated and written in buffers of at least this size.
+const size_t kMinBufferSize = 1 << 20;
+
+// Returns SplitMix64 outputs; used to expand --seed into a key.
+uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Parses 128 hex digits (the key bytes in order) into "key".
+bool ParseKey(const char* hex, uint64_t key[8]) {
+  if (strlen(hex) != 2 * River::kBlockSize) return false;
+  uint8_t bytes[River::kBlockSize];
+  for (uint32_t i = 0; i < River::kBlockSize; ++i) {
+    char digits[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    char* end;
+    bytes[i] = static_cast<uint8_t>(strtoul(digits, &end, 16));
+    if (*end != '\0') return false;
+  }
+  memcpy(key, bytes, sizeof(bytes));
+  return true;
+}
+
+// Parses a number with an optional binary K/M/G/T suffix. Returns false if
+// it is malformed or does not fit in 64 bits.
+bool ParseSize(const char* text, uint64_t* size) {
+  char* end;
+  errno = 0;
+  *size = strtoull(text, &end, 10);
+  if (errno != 0 || end == text || *text == '-') return false;
+  const char* suffixes = "KMGT";
+  const char* suffix = *end == '\0' ? nullptr : strchr(suffixes, *end);
+  if (suffix != nullptr) {
+    const int shift = 10 * (suffix - suffixes + 1);
+    if (*size > (~0ULL >> shift)) return false;
+    *size <<= shift;
+    ++end;
+  }
+  return *end == '\0';
+}
+
+double Seconds() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1E-9;
+}
 
-int main() {
-  const ALIGNED(uint64_t, 64) key[8] = {
+// Writes all "size" bytes; returns false on error (e.g. the reader exited),
+// leaving errno set.
+bool WriteAll(const uint8_t* bytes, size_t size) {
+  while (size != 0) {
+    const ssize_t written = write(STDOUT_FILENO, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  uint64_t key[8] = {
       0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
       0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
       0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
       0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL
   };
-  River river(key);
-  while (true) {
-    const uint64_t* data = river.GeneratePseudoRandomData();
-    fwrite(data, sizeof(uint64_t), River::kPacketSize / sizeof(uint64_t), stdout);
+  uint64_t max_bytes = ~0ULL;
+  uint64_t num_threads = 1;
+  bool quiet = false;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    bool ok = true;
+    if (strcmp(argv[i], "--bytes") == 0 && has_value) {
+      ok = ParseSize(argv[++i], &max_bytes);
+    } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+      ok = ParseSize(argv[++i], &num_threads) && num_threads != 0 &&
+           num_threads <= 1024;
+    } else if (strcmp(argv[i], "--key") == 0 && has_value) {
+      ok = ParseKey(argv[++i], key);
+    } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+      uint64_t seed;
+      ok = ParseSize(argv[++i], &seed);
+      for (int j = 0; j < 8; ++j) {
+        key[j] = SplitMix64(&seed);
+      }
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr,
+              "Usage: river [--bytes N[K|M|G|T]] [--threads N] "
+              "[--key 128_HEX_DIGITS | --seed N] [--quiet]\n");
+      return 1;
+    }
+  }
+
+  if (!River::Supported()) {
+    fprintf(stderr, "river: requires a CPU with AVX-2\n");
+    return 1;
+  }
+
+  // Report write errors (e.g. EPIPE when the reader exits) instead of dying.
+  signal(SIGPIPE, SIG_IGN);
+
+  ThreadPool pool(static_cast<int>(num_threads));
+  // Each thread generates at least one task per buffer.
+  const size_t buffer_size = kMinBufferSize * num_threads;
+  std::vector<uint8_t> storage(buffer_size + 64);
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+
+  const double start = Seconds();
+  uint64_t offset = 0;
+  bool ok = true;
+  int write_error = 0;  // errno of the failed write, if any.
+  while (ok && offset < max_bytes) {
+    const size_t size = std::min<uint64_t>(buffer_size, max_bytes - offset);
+    ParallelRiverFill(key, offset, buffer, size, &pool);
+    ok = WriteAll(buffer, size);
+    if (!ok) write_error = errno;
+    if (ok) offset += size;
+  }
+  const double elapsed = Seconds() - start;
+
+  if (!quiet) {
+    fprintf(stderr, "river: %llu bytes in %.3f s = %.2f GB/s (%d threads)\n",
+            static_cast<unsigned long long>(offset), elapsed,
+            offset / elapsed * 1E-9, pool.NumThreads());
+  }
+  // Stopping because the reader exited is not an error.
+  if (!ok && write_error != EPIPE) {
+    fprintf(stderr, "river: write error: %s\n", strerror(write_error));
+    return 1;
   }
-  return 0;  // Dummy return
+  return 0;
 }
@@ -16,6 +16,7 @@
 
 #include <cstring>  // memcpy
 #include "code_annotation.h"
+#include "dispatch.h"
 
 namespace {
 
@@ -23,6 +24,8 @@ const int kNumLanes = 4;
 using Lanes = uint64_t[kNumLanes];
 const int kPacketSize = sizeof(Lanes);
 
+// Same algorithm as HighwayTreeHashState in highway_tree_hash.cc, one
+// 64-bit lane at a time.
 class ScalarHighwayTreeHashState {
  public:
   INLINE ScalarHighwayTreeHashState(const Lanes& keys) {
@@ -30,29 +33,52 @@ class ScalarHighwayTreeHashState {
                          0x13198a2e03707344ull, 0x243f6a8885a308d3ull};
     const Lanes init1 = {0x3bd39e10cb0ef593ull, 0xc0acf169b5f18a8cull,
                          0xbe5466cf34e90c6cull, 0x452821e638d01377ull};
+    Lanes permuted_keys;
+    Permute(keys, &permuted_keys);
     for (int lane = 0; lane < kNumLanes; ++lane) {
-      const uint64_t key = keys[lane];
-      v0[lane] = init0[lane] ^ key;
-      v1[lane] = init1[lane] ^ key;
+      v0[lane] = init0[lane] ^ keys[lane];
+      v1[lane] = init1[lane] ^ permuted_keys[lane];
+      mul0[lane] = init0[lane];
+      mul1[lane] = init1[lane];
     }
   }
 
+  // Leaves the state uninitialized; used together with Restore.
+  INLINE ScalarHighwayTreeHashState() {}
+
+  // Copies the state to/from 16 uint64_t in the same layout as
+  // HighwayTreeHashState::Save.
+  INLINE void Save(uint64_t* RESTRICT words) const {
+    memcpy(words + 0, v0, sizeof(v0));
+    memcpy(words + 4, v1, sizeof(v1));
+    memcpy(words + 8, mul0, sizeof(mul0));
+    memcpy(words + 12, mul1, sizeof(mul1));
+  }
+
+  INLINE void Restore(const uint64_t* RESTRICT words) {
+    memcpy(v0, words + 0, sizeof(v0));
+    memcpy(v1, words + 4, sizeof(v1));
+    memcpy(mul0, words + 8, sizeof(mul0));
+    memcpy(mul1, words + 12, sizeof(mul1));
+  }
+
   INLINE void Update(const uint64_t* packets) {
     const uint64_t mask32 = 0xFFFFFFFFULL;
-    const uint64_t mask = 0x5555555555555555ull;
-    Lanes mul0, mul1;
     for (int lane = 0; lane < kNumLanes; ++lane) {
-      mul0[lane] = (v0[lane] & mask32) * (v0[lane] >> 32);
-      mul1[lane] = (v1[lane] & mask32) * (v1[lane] >> 32);
-      v0[lane] ^= packets[lane] & mask;
-      v1[lane] ^= packets[lane] & ~mask;
+      v1[lane] += packets[lane];
+      v1[lane] += mul0[lane];
+      mul0[lane] ^= (v0[lane] & mask32) * (v1[lane] >> 32);
+      v0[lane] += mul1[lane];
+      mul1[lane] ^= (v1[lane] & mask32) * (v0[lane] >> 32);
     }
     Lanes merged;
-    ZipperMerge(reinterpret_cast<const uint8_t*>(&mul1),
-                reinterpret_cast<uint8_t*>(&merged));
+    ZipperMerge(v1, &merged);
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      v0[lane] += merged[lane];
+    }
+    ZipperMerge(v0, &merged);
     for (int lane = 0; lane < kNumLanes; ++lane) {
-      v0[lane] ^= merged[lane];
-      v1[lane] ^= mul0[lane];
+      v1[lane] += merged[lane];
     }
   }
 
@@ -62,28 +88,30 @@ class ScalarHighwayTreeHashState {
     PermuteAndUpdate();
     PermuteAndUpdate();
 
-    return v0[0] + v1[0];
+    return v0[0] + v1[0] + mul0[0] + mul1[0];
   }
 
  private:
-  static INLINE void ZipperMerge(const uint8_t* mul0, uint8_t* v0) {
+  static INLINE void ZipperMerge(const Lanes& lanes, Lanes* merged_lanes) {
+    const uint8_t* v = reinterpret_cast<const uint8_t*>(lanes);
+    uint8_t* merged = reinterpret_cast<uint8_t*>(*merged_lanes);
     for (int half = 0; half < kPacketSize; half += kPacketSize / 2) {
-      v0[half + 0] = mul0[half + 3];
-      v0[half + 1] = mul0[half + 12];
-      v0[half + 2] = mul0[half + 2];
-      v0[half + 3] = mul0[half + 5];
-      v0[half + 4] = mul0[half + 14];
-      v0[half + 5] = mul0[half + 1];
-      v0[half + 6] = mul0[half + 15];
-      v0[half + 7] = mul0[half + 0];
-      v0[half + 8] = mul0[half + 11];
-      v0[half + 9] = mul0[half + 4];
-      v0[half + 10] = mul0[half + 10];
-      v0[half + 11] = mul0[half + 13];
-      v0[half + 12] = mul0[half + 9];
-      v0[half + 13] = mul0[half + 6];
-      v0[half + 14] = mul0[half + 8];
-      v0[half + 15] = mul0[half + 7];
+      merged[half + 0] = v[half + 3];
+      merged[half + 1] = v[half + 12];
+      merged[half + 2] = v[half + 2];
+      merged[half + 3] = v[half + 5];
+      merged[half + 4] = v[half + 14];
+      merged[half + 5] = v[half + 1];
+      merged[half + 6] = v[half + 15];
+      merged[half + 7] = v[half + 0];
+      merged[half + 8] = v[half + 11];
+      merged[half + 9] = v[half + 4];
+      merged[half + 10] = v[half + 10];
+      merged[half + 11] = v[half + 13];
+      merged[half + 12] = v[half + 9];
+      merged[half + 13] = v[half + 6];
+      merged[half + 14] = v[half + 8];
+      merged[half + 15] = v[half + 7];
     }
   }
 
@@ -91,16 +119,44 @@ class ScalarHighwayTreeHashState {
     return (x >> 32) | (x << 32);
   }
 
+  // Swaps the 128-bit halves and the 32-bit halves of each lane.
+  static INLINE void Permute(const Lanes& v, Lanes* permuted) {
+    (*permuted)[0] = Rot32(v[2]);
+    (*permuted)[1] = Rot32(v[3]);
+    (*permuted)[2] = Rot32(v[0]);
+    (*permuted)[3] = Rot32(v[1]);
+  }
+
   INLINE void PermuteAndUpdate() {
-    const Lanes permuted = {Rot32(v0[2]), Rot32(v0[3]), Rot32(v0[0]),
-                            Rot32(v0[1])};
+    Lanes permuted;
+    Permute(v0, &permuted);
     Update(permuted);
   }
 
-  uint64_t v0[kNumLanes];
-  uint64_t v1[kNumLanes];
+  Lanes v0;
+  Lanes v1;
+  Lanes mul0;
+  Lanes mul1;
 };
 
+// Returns the final 32-byte packet: the remaining 0..31 bytes, with the
+// lower 8 bits of "size" in the upper byte and zeros in between.
+static INLINE void LoadFinalPacket32(const uint8_t* bytes, const uint64_t size,
+                                     Lanes* final_packet) {
+  const size_t remainder = size & (kPacketSize - 1);
+  const size_t remainder_mod4 = remainder & 3;
+  uint32_t packet4 = static_cast<uint32_t>(size) << 24;
+  const uint8_t* final_bytes = bytes + remainder - remainder_mod4;
+  for (size_t i = 0; i < remainder_mod4; ++i) {
+    packet4 += static_cast<uint32_t>(final_bytes[i]) << (i * 8);
+  }
+
+  uint8_t* packet = reinterpret_cast<uint8_t*>(*final_packet);
+  memset(packet, 0, kPacketSize);
+  memcpy(packet, bytes, remainder - remainder_mod4);
+  memcpy(packet + kPacketSize - 4, &packet4, sizeof(packet4));
+}
+
 }  // namespace
 
 uint64_t ScalarHighwayTreeHash(const Lanes& key, const uint8_t* bytes,
@@ -111,24 +167,51 @@ uint64_t ScalarHighwayTreeHash(const Lanes& key, const uint8_t* bytes,
   // Hash entire 32-byte packets.
   const size_t remainder = size & (kPacketSize - 1);
   const size_t truncated_size = size - remainder;
-  const uint64_t* packets = reinterpret_cast<const uint64_t*>(bytes);
-  for (size_t i = 0; i < truncated_size / sizeof(uint64_t); i += kNumLanes) {
-    state.Update(packets + i);
+  for (size_t i = 0; i < truncated_size; i += kPacketSize) {
+    Lanes packet;
+    memcpy(packet, bytes + i, kPacketSize);
+    state.Update(packet);
   }
 
   // Update with final 32-byte packet.
-  const size_t remainder_mod4 = remainder & 3;
-  uint32_t packet4 = static_cast<uint32_t>(size) << 24;
-  const uint8_t* final_bytes = bytes + size - remainder_mod4;
-  for (size_t i = 0; i < remainder_mod4; ++i) {
-    packet4 += static_cast<uint32_t>(final_bytes[i]) << (i * 8);
+  Lanes final_packet;
+  LoadFinalPacket32(bytes + truncated_size, size, &final_packet);
+  state.Update(final_packet);
+
+  return state.Finalize();
+}
+
+void ScalarHighwayTreeHashBatch(const Lanes& key, const uint8_t* const* bytes,
+                                const uint64_t* sizes, const uint64_t num,
+                                uint64_t* hashes) {
+  for (uint64_t i = 0; i < num; ++i) {
+    hashes[i] = ScalarHighwayTreeHash(key, bytes[i], sizes[i]);
   }
+}
+
+void ScalarHighwayTreeHashReset(const Lanes& key, uint64_t* state) {
+  ScalarHighwayTreeHashState(key).Save(state);
+}
 
-  uint8_t final_packet[kPacketSize] = {0};
-  memcpy(final_packet, bytes + truncated_size, remainder - remainder_mod4);
-  memcpy(final_packet + kPacketSize - 4, &packet4, sizeof(packet4));
-  packets = reinterpret_cast<const uint64_t*>(final_packet);
-  state.Update(packets);
+void ScalarHighwayTreeHashUpdate(const uint8_t* packets,
+                                 const uint64_t num_packets, uint64_t* state) {
+  ScalarHighwayTreeHashState resumed;
+  resumed.Restore(state);
+  for (uint64_t i = 0; i < num_packets; ++i) {
+    Lanes packet;
+    memcpy(packet, packets + i * kPacketSize, kPacketSize);
+    resumed.Update(packet);
+  }
+  resumed.Save(state);
+}
 
-  return state.Finalize();
+uint64_t ScalarHighwayTreeHashFinalize(const uint64_t* state,
+                                       const uint8_t* final_bytes,
+                                       const uint64_t size) {
+  ScalarHighwayTreeHashState resumed;
+  resumed.Restore(state);
+  Lanes final_packet;
+  LoadFinalPacket32(final_bytes, size, &final_packet);
+  resumed.Update(final_packet);
+  return resumed.Finalize();
 }
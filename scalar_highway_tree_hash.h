@@ -15,7 +15,8 @@
 #ifndef HIGHWAYHASH_SCALAR_HIGHWAY_TREE_HASH_H_
 #define HIGHWAYHASH_SCALAR_HIGHWAY_TREE_HASH_H_
 
-// Scalar (non-vector/SIMD) version for comparison purposes.
+// Portable (non-SIMD) version; returns the same results as the AVX-2
+// version and is called instead of it on CPUs without AVX-2.
 
 #include <cstdint>
 
@@ -11,185 +11,162 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-
 #include "scalar_highway_tree_hash512.h"
 
 #include <cstring>  // memcpy
-#include <stdio.h>
-#include "vec_scalar.h"
+#include "code_annotation.h"
+#include "dispatch.h"
 
 namespace {
 
-// J-lanes tree hashing: see http://dx.doi.org/10.4236/jis.2014.53010
-
-// Four (2 x 64-bit) hash states are updated in parallel by injecting
-// four 64-bit packets per Update(). Finalize() combines the four states into
-// one final 64-bit digest.
+// Portable version of HighwayTreeHashState512 (highway_tree_hash512.cc).
+// Each vector instruction becomes four independent 64-bit operations, one
+// per lane; unrolling the lane loops lets the CPU execute them in parallel.
+// 32x32-bit vector multiplies become 64-bit multiplies of 32-bit values,
+// and the byte shuffle of ZipperMerge becomes shifts and masks.
 const int kNumLanes = 4;
 const int kBlockShift = 6;
 const int kBlockSize = 1 << kBlockShift;  // 64
 const int kPacketShift = 9;
 const int kPacketSize = 1 << kPacketShift;  // 512
 
-class HighwayTreeHashState512 {
+using Lanes = uint64_t[kNumLanes];
+
+static INLINE uint64_t Load64(const uint64_t* from) {
+  uint64_t word;
+  memcpy(&word, from, sizeof(word));
+  return word;
+}
+
+class ScalarHighwayTreeHashState512 {
  public:
-  explicit INLINE HighwayTreeHashState512(const uint64_t (&keys)[kNumLanes]) {
-    const ALIGNED(V4x64S, 64) init0(0x243f6a8885a308d3ull, 0x13198a2e03707344ull,
-        0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
-    const ALIGNED(V4x64S, 64) init1(0x452821e638d01377ull, 0xbe5466cf34e90c6cull,
-        0xc0acf169b5f18a8cull, 0x3bd39e10cb0ef593ull);
-    const V4x64S key = LoadU(keys);
-    // TODO: find better numbers for v2, v3.
-    v0 = init0 ^ key;
-    v1 = init1;
-    v2 = init0 + init1;
-    v3 = init0 ^ init1;
-  }
-
-  INLINE V4x64S Permute(const V4x64S& val) {
-    // For complete mixing, we need to swap the upper and lower 128-bit halves;
-    // we also swap all 32-bit halves.
-    V4x64S permuted;
-    uint64_t v = val.v_[0];
-    permuted.v_[2] = v >> 32 | v << 32;
-    v = val.v_[1];
-    permuted.v_[3] = v >> 32 | v << 32;
-    v = val.v_[2];
-    permuted.v_[0] = v >> 32 | v << 32;
-    v = val.v_[3];
-    permuted.v_[1] = v >> 32 | v << 32;
-    return permuted;
-  }
-
-  inline V4x64S Multiply(const V4x64S& a, const V4x64S& b) {
-      V4x64S r;
-      r.v_[0] = uint64_t(uint32_t(a.v_[0]))*uint32_t(b.v_[0]);
-      r.v_[1] = uint64_t(uint32_t(a.v_[1]))*uint32_t(b.v_[1]);
-      r.v_[2] = uint64_t(uint32_t(a.v_[2]))*uint32_t(b.v_[2]);
-      r.v_[3] = uint64_t(uint32_t(a.v_[3]))*uint32_t(b.v_[3]);
-      return r;
-  }
-
-  inline void Update(const V4x64S& packet1, const V4x64S& packet2) {
-    const V4x64S mask(0x5555555555555555ull);
-    V4x64S mul0(Multiply(v0, Permute(v2)));
-    V4x64S mul1(Multiply(v1, Permute(v3)));
-    V4x64S mul2(Multiply(v0 >> 32, v2));
-    V4x64S mul3(Multiply(v1 >> 32, v3));
-    v0 += packet1 & mask;
-    v1 += AndNot(mask, packet1);
-    v2 += packet2 & mask;
-    v3 += AndNot(mask, packet2);
-    v0 += ZipperMerge(v1);
-    v1 += ZipperMerge(v0);
-    v2 += ZipperMerge(v3);
-    v3 += ZipperMerge(v2);
-    v0 ^= mul3;
-    v1 ^= mul2;
-    v2 ^= mul1;
-    v3 ^= mul0;
-  }
-
-  INLINE void UpdatePacket(const uint64_t *packets) {
-    V4x64S packet1 = LoadU(packets + 0*4);
-    V4x64S packet2 = LoadU(packets + 1*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 2*4);
-    packet2 = LoadU(packets + 3*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 4*4);
-    packet2 = LoadU(packets + 5*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 6*4);
-    packet2 = LoadU(packets + 7*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 8*4);
-    packet2 = LoadU(packets + 9*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 10*4);
-    packet2 = LoadU(packets + 11*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 12*4);
-    packet2 = LoadU(packets + 13*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 14*4);
-    packet2 = LoadU(packets + 15*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 8*4);
-    packet2 = LoadU(packets + 9*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 2*4);
-    packet2 = LoadU(packets + 3*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 12*4);
-    packet2 = LoadU(packets + 13*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 6*4);
-    packet2 = LoadU(packets + 7*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 0*4);
-    packet2 = LoadU(packets + 1*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 10*4);
-    packet2 = LoadU(packets + 11*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 4*4);
-    packet2 = LoadU(packets + 5*4);
-    Update(packet1, packet2);
-    packet1 = LoadU(packets + 14*4);
-    packet2 = LoadU(packets + 15*4);
+  explicit INLINE ScalarHighwayTreeHashState512(const uint64_t (&keys)[8]) {
+    const Lanes init0 = {0xdbe6d5d5fe4cce2full, 0xa4093822299f31d0ull,
+                         0x13198a2e03707344ull, 0x243f6a8885a308d3ull};
+    const Lanes init1 = {0x3bd39e10cb0ef593ull, 0xc0acf169b5f18a8cull,
+                         0xbe5466cf34e90c6cull, 0x452821e638d01377ull};
+    for (int i = 0; i < kNumLanes; ++i) {
+      // TODO: find better numbers for v2, v3 (as in the AVX-2 version).
+      v0[i] = init0[i] ^ keys[i];
+      v1[i] = init1[i];
+      v2[i] = init0[i] + init1[i];
+      v3[i] = init0[i] ^ init1[i];
+    }
+  }
+
+  // Leaves the state uninitialized; used together with Restore.
+  INLINE ScalarHighwayTreeHashState512() {}
+
+  // Same layout as the AVX-2 HighwayTreeHashState512::Save.
+  INLINE void Save(uint64_t* RESTRICT words) const {
+    memcpy(words + 0, v0, sizeof(v0));
+    memcpy(words + 4, v1, sizeof(v1));
+    memcpy(words + 8, v2, sizeof(v2));
+    memcpy(words + 12, v3, sizeof(v3));
+  }
+
+  INLINE void Restore(const uint64_t* RESTRICT words) {
+    memcpy(v0, words + 0, sizeof(v0));
+    memcpy(v1, words + 4, sizeof(v1));
+    memcpy(v2, words + 8, sizeof(v2));
+    memcpy(v3, words + 12, sizeof(v3));
+  }
+
+  // Updates with the 64-byte block at "packets" (packet1, then packet2).
+  INLINE void Update(const uint64_t* packets) {
+    Lanes packet1, packet2;
+    for (int i = 0; i < kNumLanes; ++i) {
+      packet1[i] = Load64(packets + i);
+      packet2[i] = Load64(packets + kNumLanes + i);
+    }
     Update(packet1, packet2);
   }
 
-  INLINE uint64_t Finalize() {
+  INLINE void Update(const Lanes& packet1, const Lanes& packet2) {
+    const uint64_t kMask = 0x5555555555555555ull;
+    const uint64_t kLow32 = 0xFFFFFFFFull;
+    // The low 32 bits of Permute(v)[i] are the high 32 bits of v[i ^ 2].
+    Lanes mul0, mul1, mul2, mul3;
+    for (int i = 0; i < kNumLanes; ++i) {
+      mul0[i] = (v0[i] & kLow32) * (v2[i ^ 2] >> 32);
+      mul1[i] = (v1[i] & kLow32) * (v3[i ^ 2] >> 32);
+      mul2[i] = (v0[i ^ 2] >> 32) * (v2[i] & kLow32);
+      mul3[i] = (v1[i ^ 2] >> 32) * (v3[i] & kLow32);
+    }
+    for (int i = 0; i < kNumLanes; ++i) {
+      v0[i] += packet1[i] & kMask;
+      v1[i] += packet1[i] & ~kMask;
+      v2[i] += packet2[i] & kMask;
+      v3[i] += packet2[i] & ~kMask;
+    }
+    AddZipperMerge(v2, v0);
+    AddZipperMerge(v3, v1);
+    AddZipperMerge(v0, v2);
+    AddZipperMerge(v1, v3);
+    for (int i = 0; i < kNumLanes; ++i) {
+      v0[i] ^= mul1[i];
+      v1[i] ^= mul0[i];
+      v2[i] ^= mul3[i];
+      v3[i] ^= mul2[i];
+    }
+  }
+
+  INLINE void UpdatePacket(const uint64_t* packets) {
+    Update(packets + 0 * 8);
+    Update(packets + 1 * 8);
+    Update(packets + 2 * 8);
+    Update(packets + 3 * 8);
+    Update(packets + 4 * 8);
+    Update(packets + 5 * 8);
+    Update(packets + 6 * 8);
+    Update(packets + 7 * 8);
+    Update(packets + 4 * 8);
+    Update(packets + 1 * 8);
+    Update(packets + 6 * 8);
+    Update(packets + 3 * 8);
+    Update(packets + 0 * 8);
+    Update(packets + 5 * 8);
+    Update(packets + 2 * 8);
+    Update(packets + 7 * 8);
+  }
+
+  INLINE void Finalize(uint64_t out[8]) {
     // To make up for the 1-round lag in multiplication propagation
-    Update(Permute(v2), Permute(v3));
-    return v0.v_[0] + v1.v_[0] + v2.v_[0] + v3.v_[0];
-  }
-
-  static INLINE V4x64S ZipperMerge(const V4x64S& val) {
-    const uint8_t *v = reinterpret_cast<const uint8_t*>(val.v_);
-    V4x64S res;
-    uint8_t *r = reinterpret_cast<uint8_t*>(res.v_);
-    for (int half = 0; half < 32; half += 32 / 2) {
-      r[half + 0] = v[half + 3];
-      r[half + 1] = v[half + 12];
-      r[half + 2] = v[half + 2];
-      r[half + 3] = v[half + 5];
-      r[half + 4] = v[half + 14];
-      r[half + 5] = v[half + 1];
-      r[half + 6] = v[half + 15];
-      r[half + 7] = v[half + 0];
-      r[half + 8] = v[half + 11];
-      r[half + 9] = v[half + 4];
-      r[half + 10] = v[half + 10];
-      r[half + 11] = v[half + 13];
-      r[half + 12] = v[half + 9];
-      r[half + 13] = v[half + 6];
-      r[half + 14] = v[half + 8];
-      r[half + 15] = v[half + 7];
+    Lanes permuted0, permuted1;
+    Permute(v0, permuted0);
+    Permute(v1, permuted1);
+    Update(permuted0, permuted1);
+    Lanes permuted2, permuted3;
+    Permute(v2, permuted2);
+    Permute(v3, permuted3);
+    Update(permuted2, permuted3);
+    for (int i = 0; i < kNumLanes; ++i) {
+      out[i] = v0[i] + v1[i];
+      out[kNumLanes + i] = v2[i] + v3[i];
     }
-    return res;
   }
 
-  INLINE void UpdateFinalBlock(const uint64_t *packets) {
-    const V4x64S packet1 = LoadU(packets);
-    const V4x64S packet2 = LoadU(packets + 4);
+  INLINE void UpdateFinalBlock(const uint64_t* packets) {
+    Lanes packet1, packet2;
+    for (int i = 0; i < kNumLanes; ++i) {
+      packet1[i] = Load64(packets + i);
+      packet2[i] = Load64(packets + kNumLanes + i);
+    }
     Update(packet1, packet2);
     Update(packet2, packet1);
     Update(packet1, packet2);
     Update(packet2, packet1);
   }
 
-  INLINE void UpdateFinalPacket(const uint64_t *packets, size_t remainder) {
+  INLINE void UpdateFinalPacket(const uint64_t* packets, size_t remainder) {
     // Absorb the length to avoid collisions between messages with different
     // lengths of trailing 0's.
-    v0 ^= V4x64S(0, 0, 0, remainder);
+    v0[0] ^= remainder;
     if (remainder == kPacketSize) {
       UpdatePacket(packets);
-    } else if (remainder > kPacketSize/2) {
+    } else if (remainder > kPacketSize / 2) {
       ALIGNED(uint8_t, 64) final_packet[kPacketSize];
-      memcpy(final_packet, reinterpret_cast<const uint8_t*>(packets), remainder);
+      memcpy(final_packet, packets, remainder);
       memset(final_packet + remainder, 0, kPacketSize - remainder);
       UpdatePacket(reinterpret_cast<const uint64_t*>(final_packet));
     } else {
@@ -202,47 +179,101 @@ class HighwayTreeHashState512 {
       const size_t byte_remainder = remainder & (kBlockSize - 1);
       if (byte_remainder > 0) {
         // Final block is padded with 0's.
-        ALIGNED(uint8_t, 64) final_block[kBlockSize] = {0,};
-        memcpy(final_block, reinterpret_cast<const uint8_t*>(packets), byte_remainder);
-        memset(final_block + byte_remainder, 0, kBlockSize - byte_remainder);
+        ALIGNED(uint8_t, 64) final_block[kBlockSize] = {0};
+        memcpy(final_block, packets, byte_remainder);
         UpdateFinalBlock(reinterpret_cast<const uint64_t*>(final_block));
       }
     }
   }
 
-  void print() {
-    printf("v0 = %016lx%016lx%016lx%016lx\n", v0.v_[3], v0.v_[2], v0.v_[1], v0.v_[0]);
-    printf("v1 = %016lx%016lx%016lx%016lx\n", v1.v_[3], v1.v_[2], v1.v_[1], v1.v_[0]);
-    printf("v2 = %016lx%016lx%016lx%016lx\n", v2.v_[3], v2.v_[2], v2.v_[1], v2.v_[0]);
-    printf("v3 = %016lx%016lx%016lx%016lx\n", v3.v_[3], v3.v_[2], v3.v_[1], v3.v_[0]);
+ private:
+  // Swaps the 128-bit halves and the 32-bit halves of each lane.
+  static INLINE void Permute(const Lanes& v, Lanes& permuted) {
+    for (int i = 0; i < kNumLanes; ++i) {
+      permuted[i] = (v[i ^ 2] >> 32) | (v[i ^ 2] << 32);
+    }
   }
 
-  V4x64S v0;
-  V4x64S v1;
-  V4x64S v2;
-  V4x64S v3;
+  // sum += ZipperMerge(v), where ZipperMerge rearranges the bytes of each
+  // 128-bit half (lanes 0-1 and 2-3) as in HighwayTreeHashState512: byte
+  // indices 3 12 2 5 14 1 15 0 11 4 10 13 9 6 8 7.
+  static INLINE void AddZipperMerge(const Lanes& v, Lanes& sum) {
+    for (int i = 0; i < kNumLanes; i += 2) {
+      const uint64_t lo = v[i];
+      const uint64_t hi = v[i + 1];
+      sum[i] += ((lo >> 24) & 0x00000000000000FFull) |
+                ((hi >> 24) & 0x000000000000FF00ull) |
+                (lo & 0x0000000000FF0000ull) |
+                ((lo >> 16) & 0x00000000FF000000ull) |
+                ((hi >> 16) & 0x000000FF00000000ull) |
+                ((lo << 32) & 0x0000FF0000000000ull) |
+                ((hi >> 8) & 0x00FF000000000000ull) | (lo << 56);
+      sum[i + 1] += ((hi >> 24) & 0x00000000000000FFull) |
+                    ((lo >> 24) & 0x000000000000FF00ull) |
+                    (hi & 0x0000000000FF0000ull) |
+                    ((hi >> 16) & 0x00000000FF000000ull) |
+                    ((hi << 24) & 0x000000FF00000000ull) |
+                    ((lo >> 8) & 0x0000FF0000000000ull) |
+                    ((hi << 48) & 0x00FF000000000000ull) |
+                    (lo & 0xFF00000000000000ull);
+    }
+  }
+
+  Lanes v0;
+  Lanes v1;
+  Lanes v2;
+  Lanes v3;
 };
 
 }  // namespace
 
-uint64_t ScalarHighwayTreeHash512(const uint64_t (&key)[4], const uint8_t* bytes,
-                         const uint64_t size) {
-  HighwayTreeHashState512 state(key);
+void ScalarHighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                              const uint64_t size, uint64_t out[8]) {
+  ScalarHighwayTreeHashState512 state(key);
 
   size_t num_full_packets = size >> kPacketShift;
   if ((size & (kPacketSize - 1)) == 0 && num_full_packets > 0) {
-    // The last block is hashed differently, so make sure we still have data to hash.
+    // The last packet is hashed differently.
     num_full_packets--;
   }
-  // Note: this requires aligned input data, which wont be true in general.
   const uint64_t* packets = reinterpret_cast<const uint64_t*>(bytes);
   for (size_t i = 0; i < num_full_packets; ++i) {
     state.UpdatePacket(packets);
     packets += kPacketSize / sizeof(uint64_t);
   }
-  size_t remainder = size - (num_full_packets << kPacketShift);
+  const size_t remainder = size - (num_full_packets << kPacketShift);
+  if (remainder > 0) {
+    state.UpdateFinalPacket(packets, remainder);
+  }
+  state.Finalize(out);
+}
+
+void ScalarHighwayTreeHash512Reset(const uint64_t (&key)[8], uint64_t* state) {
+  ScalarHighwayTreeHashState512(key).Save(state);
+}
+
+void ScalarHighwayTreeHash512Update(const uint8_t* packets,
+                                    const uint64_t num_packets,
+                                    uint64_t* state) {
+  ScalarHighwayTreeHashState512 resumed;
+  resumed.Restore(state);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(packets);
+  for (uint64_t i = 0; i < num_packets; ++i) {
+    resumed.UpdatePacket(words);
+    words += kPacketSize / sizeof(uint64_t);
+  }
+  resumed.Save(state);
+}
+
+void ScalarHighwayTreeHash512Finalize(const uint64_t* state,
+                                      const uint8_t* final_bytes,
+                                      const uint64_t remainder,
+                                      uint64_t out[8]) {
+  ScalarHighwayTreeHashState512 resumed;
+  resumed.Restore(state);
   if (remainder > 0) {
-      state.UpdateFinalPacket(packets, remainder);
+    resumed.UpdateFinalPacket(reinterpret_cast<const uint64_t*>(final_bytes),
+                              remainder);
   }
-  return state.Finalize();
+  resumed.Finalize(out);
 }
@@ -17,17 +17,9 @@
 
 #include <cstdint>
 
-// J-lanes tree hash based upon multiplication and "zipper merges".
-//
-// Robust versus timing attacks because memory accesses are sequential
-// and the algorithm is branch-free. Requires an AVX-2 capable CPU.
-//
-// "key" is a secret 256-bit key unknown to attackers.
-// "bytes" is the data to hash (possibly unaligned).
-// "size" is the number of bytes to hash; exactly that many bytes are read.
-//
-// Returns a 64-bit hash of the given data bytes.
-uint64_t ScalarHighwayTreeHash512(const uint64_t (&key)[4], const uint8_t* bytes,
-                         const uint64_t size);
+// Portable (non-SIMD) version of HighwayTreeHash512; returns the same
+// results. Called by HighwayTreeHash512 on CPUs without AVX-2.
+void ScalarHighwayTreeHash512(const uint64_t (&key)[8], const uint8_t* bytes,
+                              const uint64_t size, uint64_t out[8]);
 
 #endif  // #ifndef HIGHWAYHASH_SCALAR_HIGHWAY_TREE_HASH512_H_
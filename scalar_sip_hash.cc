@@ -0,0 +1,130 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "scalar_sip_hash.h"
+
+#include <cstring>  // memcpy
+#include "code_annotation.h"
+#include "dispatch.h"
+
+namespace {
+
+// Paper: https://www.131002.net/siphash/siphash.pdf
+
+// 32 bytes. Parameters are hardwired to c=2, d=4 [rounds].
+class ScalarSipHashState {
+ public:
+  explicit INLINE ScalarSipHashState(const uint64_t keys[2]) {
+    v0 = 0x736f6d6570736575ull ^ keys[0];
+    v1 = 0x646f72616e646f6dull ^ keys[1];
+    v2 = 0x6c7967656e657261ull ^ keys[0];
+    v3 = 0x7465646279746573ull ^ keys[1];
+  }
+
+  INLINE void Update(const uint64_t packet) {
+    v3 ^= packet;
+
+    Compress<2>();
+
+    v0 ^= packet;
+  }
+
+  INLINE uint64_t Finalize() {
+    // Mix in bits to avoid leaking the key if all packets were zero.
+    v2 ^= 0xFF;
+
+    Compress<4>();
+
+    return (v0 ^ v1) ^ (v2 ^ v3);
+  }
+
+ private:
+  // Rotate a 64-bit value "v" left by N bits.
+  template <uint64_t bits>
+  static INLINE uint64_t RotateLeft(const uint64_t v) {
+    const uint64_t left = v << bits;
+    const uint64_t right = v >> (64 - bits);
+    return left | right;
+  }
+
+  template <size_t rounds>
+  INLINE void Compress() {
+    for (size_t i = 0; i < rounds; ++i) {
+      // ARX network: add, rotate, exclusive-or.
+      v0 += v1;
+      v2 += v3;
+      v1 = RotateLeft<13>(v1);
+      v3 = RotateLeft<16>(v3);
+      v1 ^= v0;
+      v3 ^= v2;
+
+      v0 = RotateLeft<32>(v0);
+
+      v2 += v1;
+      v0 += v3;
+      v1 = RotateLeft<17>(v1);
+      v3 = RotateLeft<21>(v3);
+      v1 ^= v2;
+      v3 ^= v0;
+
+      v2 = RotateLeft<32>(v2);
+    }
+  }
+
+  uint64_t v0;
+  uint64_t v1;
+  uint64_t v2;
+  uint64_t v3;
+};
+
+}  // namespace
+
+uint64_t ScalarSipHash(const uint64_t key[2], const uint8_t* bytes,
+                       const uint64_t size) {
+  ScalarSipHashState state(key);
+
+  size_t offset = 0;
+  for (; offset < (size & ~7); offset += 8) {
+    uint64_t packet;
+    memcpy(&packet, bytes + offset, sizeof(packet));
+    state.Update(packet);
+  }
+
+  // Remaining 0..7 bytes, with "size & 0xFF" in the upper byte.
+  uint8_t final_packet[8] = {0};
+  memcpy(final_packet, bytes + offset, size - offset);
+  final_packet[7] = size;
+  uint64_t packet;
+  memcpy(&packet, final_packet, sizeof(packet));
+  state.Update(packet);
+
+  return state.Finalize();
+}
+
+uint64_t ScalarReduceSipTreeHash(const uint64_t key[2],
+                                 const uint64_t hashes[4]) {
+  ScalarSipHashState state(key);
+
+  for (int i = 0; i < 4; ++i) {
+    state.Update(hashes[i]);
+  }
+
+  return state.Finalize();
+}
+
+void ScalarSipHashBatch(const uint64_t key[2], const uint8_t* const bytes[4],
+                        const uint64_t sizes[4], uint64_t hashes[4]) {
+  for (int i = 0; i < 4; ++i) {
+    hashes[i] = ScalarSipHash(key, bytes[i], sizes[i]);
+  }
+}
@@ -0,0 +1,37 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_SCALAR_SIP_HASH_H_
+#define HIGHWAYHASH_SCALAR_SIP_HASH_H_
+
+// Portable (non-SIMD) versions of SipHash and ReduceSipTreeHash; they
+// return the same results and are called by the public functions on CPUs
+// without AVX-2.
+
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t ScalarSipHash(const uint64_t key[2], const uint8_t* bytes,
+                       const uint64_t size);
+
+uint64_t ScalarReduceSipTreeHash(const uint64_t key[2],
+                                 const uint64_t hashes[4]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // #ifndef HIGHWAYHASH_SCALAR_SIP_HASH_H_
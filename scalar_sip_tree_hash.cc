@@ -13,7 +13,7 @@
 // limitations under the License.
 
 #include "scalar_sip_tree_hash.h"
-#include "sip_hash.h"
+#include "scalar_sip_hash.h"
 
 #include <cstring>  // memcpy
 #include "code_annotation.h"
@@ -140,5 +140,5 @@ uint64_t ScalarSipTreeHash(const Lanes& key,
     hashes[lane] = state[lane].Finalize();
   }
 
-  return ReduceSipTreeHash(key, hashes);
+  return ScalarReduceSipTreeHash(key, hashes);
 }
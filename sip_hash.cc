@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "sip_hash.h"
+#include "dispatch.h"
 
 #include <cstring>  // memcpy
 #include "vec.h"
@@ -125,8 +125,8 @@ static INLINE V2x64U LoadFinalPacket64(const uint8_t* bytes,
 
 }  // namespace
 
-uint64_t SipHash(const uint64_t key[2], const uint8_t* bytes,
-                 const uint64_t size) {
+uint64_t AVX2SipHash(const uint64_t key[2], const uint8_t* bytes,
+                     const uint64_t size) {
   SipHashState state(key);
 
   size_t offset = 0;
@@ -141,7 +141,8 @@ uint64_t SipHash(const uint64_t key[2], const uint8_t* bytes,
   return state.Finalize();
 }
 
-uint64_t ReduceSipTreeHash(const uint64_t key[2], const uint64_t hashes[4]) {
+uint64_t AVX2ReduceSipTreeHash(const uint64_t key[2],
+                               const uint64_t hashes[4]) {
   SipHashState state(key);
 
   for (int i = 0; i < 4; ++i) {
@@ -31,7 +31,7 @@ extern "C" {
 // Robust versus timing attacks because memory accesses are sequential
 // and the algorithm is branch-free. Compute time is proportional to the
 // number of 8-byte packets and 1.5x faster than an sse41 implementation.
-// Requires an AVX-2 capable CPU.
+// Falls back to a portable implementation on CPUs without AVX-2.
 //
 // "key" is a secret 128-bit key unknown to attackers.
 // "bytes" is the data to hash; ceil(size / 8) * 8 bytes are read.
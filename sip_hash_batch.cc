@@ -0,0 +1,204 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dispatch.h"
+
+#include <algorithm>
+#include <cstring>  // memcpy
+#include "vec2.h"
+
+namespace {
+
+// Paper: https://www.131002.net/siphash/siphash.pdf
+
+// Each of the four 64-bit lanes holds the state of one message. Unlike
+// SipTreeHash, the lanes are never combined, so each yields the SipHash
+// of its own message.
+const int kNumLanes = 4;
+
+// 4 x 32 bytes. Parameters are hardwired to c=2, d=4 [rounds].
+class SipHashBatchState {
+ public:
+  explicit INLINE SipHashBatchState(const uint64_t keys[2]) {
+    const V4x64U key0(keys[0]);
+    const V4x64U key1(keys[1]);
+    v0 = key0 ^ V4x64U(0x736f6d6570736575ull);
+    v1 = key1 ^ V4x64U(0x646f72616e646f6dull);
+    v2 = key0 ^ V4x64U(0x6c7967656e657261ull);
+    v3 = key1 ^ V4x64U(0x7465646279746573ull);
+  }
+
+  INLINE void Update(const V4x64U& packets) {
+    v3 ^= packets;
+
+    Compress<2>();
+
+    v0 ^= packets;
+  }
+
+  // Updates all lanes except those whose "ended" mask is all-ones; these
+  // keep their previous state because their message has no more packets.
+  INLINE void UpdateMasked(const V4x64U& packets, const V4x64U& ended) {
+    const V4x64U prev0 = v0;
+    const V4x64U prev1 = v1;
+    const V4x64U prev2 = v2;
+    const V4x64U prev3 = v3;
+    Update(packets);
+    v0 = Select(v0, prev0, ended);
+    v1 = Select(v1, prev1, ended);
+    v2 = Select(v2, prev2, ended);
+    v3 = Select(v3, prev3, ended);
+  }
+
+  INLINE V4x64U Finalize() {
+    // Mix in bits to avoid leaking the key if all packets were zero.
+    v2 ^= V4x64U(0xFF);
+
+    Compress<4>();
+
+    return (v0 ^ v1) ^ (v2 ^ v3);
+  }
+
+ private:
+  // Returns "yes" in lanes where "mask" is all-ones, otherwise "no".
+  static INLINE V4x64U Select(const V4x64U& no, const V4x64U& yes,
+                              const V4x64U& mask) {
+    return V4x64U(_mm256_blendv_epi8(no, yes, mask));
+  }
+
+  static INLINE V4x64U RotateLeft16(const V4x64U& v) {
+    const V4x64U control(0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL,
+                         0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL);
+    return V4x64U(_mm256_shuffle_epi8(v, control));
+  }
+
+  // Rotates each 64-bit element of "v" left by N bits.
+  template <uint64_t bits>
+  static INLINE V4x64U RotateLeft(const V4x64U& v) {
+    const V4x64U left = v << bits;
+    const V4x64U right = v >> (64 - bits);
+    return left | right;
+  }
+
+  static INLINE V4x64U Rotate32(const V4x64U& v) {
+    return V4x64U(_mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+
+  template <size_t rounds>
+  INLINE void Compress() {
+    // Loop is faster than unrolling!
+    for (size_t i = 0; i < rounds; ++i) {
+      // ARX network: add, rotate, exclusive-or.
+      v0 += v1;
+      v2 += v3;
+      v1 = RotateLeft<13>(v1);
+      v3 = RotateLeft16(v3);
+      v1 ^= v0;
+      v3 ^= v2;
+
+      v0 = Rotate32(v0);
+
+      v2 += v1;
+      v0 += v3;
+      v1 = RotateLeft<17>(v1);
+      v3 = RotateLeft<21>(v3);
+      v1 ^= v2;
+      v3 ^= v0;
+
+      v2 = Rotate32(v2);
+    }
+  }
+
+  V4x64U v0;
+  V4x64U v1;
+  V4x64U v2;
+  V4x64U v3;
+};
+
+static INLINE uint64_t LoadPacket64(const uint8_t* bytes) {
+  uint64_t packet;
+  memcpy(&packet, bytes, sizeof(packet));
+  return packet;
+}
+
+// Returns the final packet of a message: the remaining 0..7 bytes, with
+// "size & 0xFF" in the upper byte and zeros in between. Only reads the
+// remaining bytes, so this cannot fault.
+static INLINE uint64_t LoadFinalPacket64(const uint8_t* bytes,
+                                         const uint64_t size) {
+  const size_t offset = size & ~7;
+  uint64_t packet = 0;
+  memcpy(&packet, bytes + offset, size - offset);
+  return packet | (size << 56);
+}
+
+// Returns packet "index" of a message with "num_full" whole 8-byte packets
+// followed by "final_packet"; zero if the message has already ended (that
+// lane is then masked off). The first branch is predictable because it only
+// changes once per message.
+static INLINE uint64_t PacketOrFinal(const uint8_t* bytes,
+                                     const uint64_t num_full,
+                                     const uint64_t final_packet,
+                                     const uint64_t index) {
+  if (index < num_full) {
+    return LoadPacket64(bytes + index * 8);
+  }
+  return (index == num_full) ? final_packet : 0;
+}
+
+}  // namespace
+
+void AVX2SipHashBatch(const uint64_t key[2],
+                      const uint8_t* const bytes[kNumLanes],
+                      const uint64_t sizes[kNumLanes],
+                      uint64_t hashes[kNumLanes]) {
+  SipHashBatchState state(key);
+
+  // Each message has num_full[i] whole packets followed by a final packet.
+  uint64_t num_full[kNumLanes];
+  for (int i = 0; i < kNumLanes; ++i) {
+    num_full[i] = sizes[i] / 8;
+  }
+  const uint64_t min_full = *std::min_element(num_full, num_full + kNumLanes);
+  const uint64_t max_full = *std::max_element(num_full, num_full + kNumLanes);
+
+  // All lanes active: no masking required.
+  uint64_t index = 0;
+  for (; index < min_full; ++index) {
+    const V4x64U packets(LoadPacket64(bytes[3] + index * 8),
+                         LoadPacket64(bytes[2] + index * 8),
+                         LoadPacket64(bytes[1] + index * 8),
+                         LoadPacket64(bytes[0] + index * 8));
+    state.Update(packets);
+  }
+
+  // Lengths diverge: lanes stay active until (including) their final packet.
+  // Comparisons are signed, which is fine for sizes below 2^63.
+  uint64_t final_packets[kNumLanes];
+  for (int i = 0; i < kNumLanes; ++i) {
+    final_packets[i] = LoadFinalPacket64(bytes[i], sizes[i]);
+  }
+  const V4x64U last(num_full[3], num_full[2], num_full[1], num_full[0]);
+  for (; index <= max_full; ++index) {
+    const V4x64U packets(
+        PacketOrFinal(bytes[3], num_full[3], final_packets[3], index),
+        PacketOrFinal(bytes[2], num_full[2], final_packets[2], index),
+        PacketOrFinal(bytes[1], num_full[1], final_packets[1], index),
+        PacketOrFinal(bytes[0], num_full[0], final_packets[0], index));
+    const V4x64U ended(_mm256_cmpgt_epi64(V4x64U(index), last));
+    state.UpdateMasked(packets, ended);
+  }
+
+  StoreU(state.Finalize(), hashes);
+}
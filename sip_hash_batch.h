@@ -0,0 +1,40 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_SIP_HASH_BATCH_H_
+#define HIGHWAYHASH_SIP_HASH_BATCH_H_
+
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Computes hashes[i] = SipHash(key, bytes[i], sizes[i]) for four independent
+// messages at once, one per 64-bit lane of an AVX-2 register. The results
+// are standard SipHash-2-4 values. Messages may have different lengths;
+// lanes whose message has ended are left unchanged while the others continue,
+// so the cost is proportional to the longest message.
+// Without AVX-2, computes the four hashes one after the other.
+//
+// "key" is a secret 128-bit key unknown to attackers.
+// "bytes[i]" is the data to hash; exactly "sizes[i]" bytes are read.
+void SipHashBatch(const uint64_t key[2], const uint8_t* const bytes[4],
+                  const uint64_t sizes[4], uint64_t hashes[4]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // #ifndef HIGHWAYHASH_SIP_HASH_BATCH_H_
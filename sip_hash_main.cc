@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -24,15 +28,23 @@
 #include <time.h>
 #endif
 
+#include "dispatch.h"
+#include "highway_merkle_tree.h"
 #include "highway_tree_hash.h"
 #include "highway_tree_hash512.h"
+#include "instruction_sets.h"
+#include "parallel_highway_tree_hash512.h"
+#include "parallel_river.h"
 #include "scalar_highway_tree_hash.h"
 #include "scalar_highway_tree_hash512.h"
+#include "scalar_sip_hash.h"
 #include "scalar_sip_tree_hash.h"
 #include "river.h"
+#include "river_distributions.h"
 #include "sip_hash.h"
+#include "sip_hash_batch.h"
 #include "sip_tree_hash.h"
-#include "vec2.h"
+#include "thread_pool.h"
 
 uint64_t TimerTicks() {
 #ifdef _WIN32
@@ -159,6 +171,930 @@ static void VerifyEqual(const char* caption, const Function1& hash_function1,
   printf("Verified %s.\n", caption);
 }
 
+// Same as VerifyEqual, for functions returning 512-bit hashes. Covers all
+// sizes up to 4 KiB, i.e. several whole and partial 512-byte packets.
+template <class Function1, class Function2>
+static void VerifyEqual512(const char* caption,
+                           const Function1& hash_function1,
+                           const Function2& hash_function2) {
+  const int kMaxSize = 4097;
+  ALIGNED(uint8_t, 64) in[kMaxSize] = {0};
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+
+  for (int size = 0; size < kMaxSize; ++size) {
+    in[size] = static_cast<uint8_t>(size);
+    ALIGNED(uint64_t, 64) hash[8];
+    ALIGNED(uint64_t, 64) hash2[8];
+    hash_function1(key, in, size, hash);
+    hash_function2(key, in, size, hash2);
+    if (memcmp(hash, hash2, sizeof(hash)) != 0) {
+      printf("Failed for length %d %lx %lx\n", size, hash[0], hash2[0]);
+      exit(1);
+    }
+  }
+  printf("Verified %s.\n", caption);
+}
+
+// Verifies HighwayTreeHashStream matches HighwayTreeHash for any splitting
+// of the input into fragments.
+static void VerifyStream() {
+  const int kMaxSize = 300;
+  ALIGNED(uint8_t, 64) in[kMaxSize];
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+  const int fragment_sizes[] = {1, 3, 31, 32, 33, 64, 100, kMaxSize};
+  for (int size = 0; size < kMaxSize; ++size) {
+    in[size] = static_cast<uint8_t>(size);
+    const uint64_t expected = HighwayTreeHash(key, in, size);
+    for (const int fragment_size : fragment_sizes) {
+      HighwayTreeHashStream stream(key);
+      for (int pos = 0; pos < size; pos += fragment_size) {
+        stream.Update(in + pos, std::min(fragment_size, size - pos));
+      }
+      const uint64_t hash = stream.Finalize();
+      if (hash != expected) {
+        printf("Failed for length %d fragment %d %lx %lx\n", size,
+               fragment_size, hash, expected);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified HighwayTree stream.\n");
+}
+
+// Verifies HighwayTreeHashStream512 matches HighwayTreeHash512 for any
+// splitting of the input, including fragments ending on packet boundaries.
+static void VerifyStream512() {
+  const int kMaxSize = 1600;
+  ALIGNED(uint8_t, 64) in[kMaxSize];
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+
+  const int fragment_sizes[] = {1, 63, 511, 512, 513, 1000, kMaxSize};
+  for (int size = 0; size < kMaxSize; ++size) {
+    in[size] = static_cast<uint8_t>(size);
+    ALIGNED(uint64_t, 64) expected[8];
+    HighwayTreeHash512(key, in, size, expected);
+    for (const int fragment_size : fragment_sizes) {
+      HighwayTreeHashStream512 stream(key);
+      for (int pos = 0; pos < size; pos += fragment_size) {
+        stream.Update(in + pos, std::min(fragment_size, size - pos));
+      }
+      ALIGNED(uint64_t, 64) hash[8];
+      stream.Finalize(hash);
+      if (memcmp(hash, expected, sizeof(hash)) != 0) {
+        printf("Failed for length %d fragment %d %lx %lx\n", size,
+               fragment_size, hash[0], expected[0]);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified HighwayTree512 stream.\n");
+}
+
+// Verifies ParallelHighwayTreeHash512 matches a serial computation of its
+// definition, for any number of threads and with or without pinning.
+static void VerifyParallel() {
+  const uint64_t kMaxSize = 3 * kParallelLeafSize + 12345;
+  std::vector<uint8_t> in(kMaxSize);
+  for (uint64_t i = 0; i < kMaxSize; ++i) {
+    in[i] = static_cast<uint8_t>(i * 0x9D + (i >> 13));
+  }
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  uint64_t root_key[8];
+  for (int i = 0; i < 8; ++i) {
+    root_key[i] = key[i] ^ 0xA5A5A5A5A5A5A5A5ULL;
+  }
+
+  ThreadPool pool1(1);
+  ThreadPool pool2(2);
+  ThreadPool pool3_pinned(3, true);
+  ThreadPool pool8(8);
+  ThreadPool* pools[] = {&pool1, &pool2, &pool3_pinned, &pool8};
+  const uint64_t sizes[] = {0, 1, kParallelLeafSize - 1, kParallelLeafSize,
+                            kParallelLeafSize + 1, kMaxSize};
+  for (const uint64_t size : sizes) {
+    const uint64_t num_leaves =
+        (size + kParallelLeafSize - 1) / kParallelLeafSize;
+    std::vector<uint64_t> root_input(num_leaves * 8 + 1);
+    for (uint64_t leaf = 0; leaf < num_leaves; ++leaf) {
+      const uint64_t begin = leaf * kParallelLeafSize;
+      HighwayTreeHash512(key, in.data() + begin,
+                         std::min(kParallelLeafSize, size - begin),
+                         &root_input[leaf * 8]);
+    }
+    root_input[num_leaves * 8] = size;
+    uint64_t expected[8];
+    HighwayTreeHash512(root_key,
+                       reinterpret_cast<const uint8_t*>(root_input.data()),
+                       root_input.size() * sizeof(uint64_t), expected);
+
+    for (ThreadPool* pool : pools) {
+      uint64_t hash[8];
+      ParallelHighwayTreeHash512(key, in.data(), size, pool, hash);
+      if (memcmp(hash, expected, sizeof(hash)) != 0) {
+        printf("Failed for length %lu threads %d %lx %lx\n", size,
+               pool->NumThreads(), hash[0], expected[0]);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified HighwayTree512 parallel.\n");
+}
+
+// Verifies HighwayMerkleTree::UpdateRange results in the same root as
+// rebuilding the tree, and that proofs verify exactly the original chunks.
+static void VerifyMerkleTree() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const uint64_t sizes[] = {0, 1, 4096, 4097, 3 * 4096 + 5, 100000};
+  const uint64_t chunk_sizes[] = {1000, 4096};
+  for (const uint64_t size : sizes) {
+    for (const uint64_t chunk_size : chunk_sizes) {
+      // Chunks must differ, otherwise proofs are also valid for other chunks.
+      std::vector<uint8_t> in(size);
+      for (uint64_t i = 0; i < size; ++i) {
+        in[i] = static_cast<uint8_t>((i * 0x9E3779B97F4A7C15ULL) >> 56);
+      }
+      HighwayMerkleTree tree(key, in.data(), size, chunk_size);
+
+      // Modify ranges of various lengths and positions.
+      uint64_t seed = 0x123456789ULL;
+      for (int rep = 0; rep < 20 && size != 0; ++rep) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t offset = (seed >> 20) % size;
+        const uint64_t num_bytes =
+            std::min(size - offset, 1 + (seed >> 40) % (3 * chunk_size));
+        for (uint64_t i = offset; i < offset + num_bytes; ++i) {
+          in[i] ^= static_cast<uint8_t>(seed >> 8) | 1;
+        }
+        const uint64_t old_root = tree.Root()[0];
+        tree.UpdateRange(in.data(), offset, num_bytes);
+        const HighwayMerkleTree rebuilt(key, in.data(), size, chunk_size);
+        if (memcmp(tree.Root(), rebuilt.Root(),
+                   HighwayMerkleTree::kDigestWords * sizeof(uint64_t)) != 0 ||
+            tree.Root()[0] == old_root) {
+          printf("Merkle update failed for size %lu offset %lu bytes %lu\n",
+                 size, offset, num_bytes);
+          exit(1);
+        }
+      }
+
+      // Ranges past the end are clipped.
+      std::vector<uint64_t> root(tree.Root(),
+                                 tree.Root() + HighwayMerkleTree::kDigestWords);
+      tree.UpdateRange(in.data(), size / 2, ~0ULL);
+      tree.UpdateRange(in.data(), size + chunk_size, 1);
+      if (!std::equal(root.begin(), root.end(), tree.Root())) {
+        printf("Merkle clipping failed for size %lu\n", size);
+        exit(1);
+      }
+
+      for (uint64_t chunk = 0; chunk < tree.NumChunks(); ++chunk) {
+        const uint8_t* chunk_bytes = in.data() + chunk * chunk_size;
+        const std::vector<uint64_t> proof = tree.Proof(chunk);
+        if (!HighwayMerkleTree::VerifyChunk(key, size, chunk_size, chunk,
+                                            chunk_bytes, proof, tree.Root())) {
+          printf("Merkle proof failed for size %lu chunk %lu\n", size, chunk);
+          exit(1);
+        }
+        // Other chunks or modified contents must not verify.
+        const bool other_ok =
+            tree.NumChunks() > 1 &&
+            HighwayMerkleTree::VerifyChunk(key, size, chunk_size,
+                                           chunk ^ 1, chunk_bytes, proof,
+                                           tree.Root());
+        bool modified_ok = false;
+        if (size != 0) {
+          in[chunk * chunk_size] ^= 1;
+          modified_ok = HighwayMerkleTree::VerifyChunk(
+              key, size, chunk_size, chunk, chunk_bytes, proof, tree.Root());
+          in[chunk * chunk_size] ^= 1;
+        }
+        if (other_ok || modified_ok) {
+          printf("Merkle accepted wrong chunk for size %lu chunk %lu\n", size,
+                 chunk);
+          exit(1);
+        }
+      }
+    }
+  }
+  printf("Verified HighwayMerkleTree.\n");
+}
+
+// Verifies River::Fill and FillXor return the concatenation of
+// GeneratePseudoRandomData packets for any sizes and alignments.
+static void VerifyRiverFill() {
+  const ALIGNED(uint64_t, 64) key[8] = {
+      0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+      0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+      0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+      0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  // Large enough for streaming stores.
+  const size_t kSize = (3 << 20) + 1000;
+  std::vector<uint8_t> expected(kSize);
+  River reference(key);
+  for (size_t pos = 0; pos < kSize; pos += River::kPacketSize) {
+    const uint64_t* packet = reference.GeneratePseudoRandomData();
+    memcpy(expected.data() + pos, packet,
+           std::min<size_t>(River::kPacketSize, kSize - pos));
+  }
+
+  // Sizes of consecutive calls; 0 terminates. Includes unaligned heads and
+  // tails and whole packets written after a partial packet.
+  const size_t sizes[] = {1, 31, 480, 512, 7, 1029, 2 << 20, 3, 5000, 0};
+  for (int misalign = 0; misalign < 33; misalign += 8) {
+    std::vector<uint8_t> storage(kSize + 64);
+    uint8_t* out = storage.data() + misalign;
+    std::vector<uint8_t> xored(kSize);
+    for (size_t i = 0; i < kSize; ++i) {
+      xored[i] = static_cast<uint8_t>(i * 0x9D);
+    }
+
+    River river(key);
+    River river_xor(key);
+    size_t pos = 0;
+    for (int i = 0; sizes[i] != 0; ++i) {
+      river.Fill(out + pos, sizes[i]);
+      river_xor.FillXor(xored.data() + pos, sizes[i]);
+      pos += sizes[i];
+    }
+    river.Fill(out + pos, kSize - pos);
+    river_xor.FillXor(xored.data() + pos, kSize - pos);
+
+    for (size_t i = 0; i < kSize; ++i) {
+      if (out[i] != expected[i] ||
+          (xored[i] ^ static_cast<uint8_t>(i * 0x9D)) != expected[i]) {
+        printf("River fill mismatch at %zu misalign %d\n", i, misalign);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified River fill.\n");
+}
+
+// Verifies SeekableRiver returns the same bytes after seeking as when
+// generating the stream sequentially.
+static void VerifySeekableRiver() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const size_t kSize = 5 * SeekableRiver::kSegmentSize + 777;
+  std::vector<uint8_t> expected(kSize);
+  SeekableRiver sequential(key);
+  for (size_t pos = 0; pos < kSize; pos += 1000) {
+    sequential.Fill(expected.data() + pos, std::min<size_t>(1000, kSize - pos));
+  }
+  // Segments must differ.
+  if (memcmp(expected.data(), expected.data() + SeekableRiver::kSegmentSize,
+             River::kPacketSize) == 0) {
+    printf("SeekableRiver segments are identical\n");
+    exit(1);
+  }
+
+  SeekableRiver river(key);
+  std::vector<uint8_t> out(kSize);
+  uint64_t seed = 0x123456789ULL;
+  for (int rep = 0; rep < 200; ++rep) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    const size_t offset = (seed >> 16) % kSize;
+    const size_t size = std::min<size_t>((seed >> 40) % 70000, kSize - offset);
+    river.Seek(offset);
+    if (rep & 1) {
+      memset(out.data(), 0, size);
+      river.FillXor(out.data(), size);
+    } else {
+      river.Fill(out.data(), size);
+    }
+    // Copies continue from the same position.
+    SeekableRiver copy = river;
+    uint8_t next[2];
+    river.Fill(next, 1);
+    copy.Fill(next + 1, 1);
+    // Constructing at "offset" is equivalent to seeking there.
+    SeekableRiver started(key, nullptr, offset);
+    uint8_t first;
+    started.Fill(&first, 1);
+    if (memcmp(out.data(), expected.data() + offset, size) != 0 ||
+        first != expected[offset] ||
+        river.Position() != offset + size + 1 || next[0] != next[1] ||
+        (offset + size < kSize && next[0] != expected[offset + size])) {
+      printf("SeekableRiver mismatch at offset %zu size %zu\n", offset, size);
+      exit(1);
+    }
+  }
+  printf("Verified SeekableRiver.\n");
+}
+
+// Verifies ParallelRiverFill matches SeekableRiver for any number of threads,
+// offsets and sizes.
+static void VerifyParallelRiver() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const size_t kMaxSize = 3 * kParallelRiverTaskSize + 12345;
+  std::vector<uint8_t> expected(kMaxSize);
+  std::vector<uint8_t> out(kMaxSize);
+
+  ThreadPool pool1(1);
+  ThreadPool pool2(2);
+  ThreadPool pool3_pinned(3, true);
+  ThreadPool pool8(8);
+  ThreadPool* pools[] = {&pool1, &pool2, &pool3_pinned, &pool8};
+  const uint64_t offsets[] = {0, 1, kParallelRiverTaskSize - 5,
+                              7 * SeekableRiver::kSubstreamSize + 999};
+  const size_t sizes[] = {0, 1, 600, kParallelRiverTaskSize, kMaxSize};
+  for (const uint64_t offset : offsets) {
+    for (const size_t size : sizes) {
+      SeekableRiver river(key);
+      river.Seek(offset);
+      river.Fill(expected.data(), size);
+      for (ThreadPool* pool : pools) {
+        memset(out.data(), 0, size);
+        ParallelRiverFill(key, offset, out.data(), size, pool);
+        if (memcmp(out.data(), expected.data(), size) != 0) {
+          printf("ParallelRiverFill mismatch offset %lu size %zu threads %d\n",
+                 offset, size, pool->NumThreads());
+          exit(1);
+        }
+      }
+    }
+  }
+  printf("Verified River parallel.\n");
+}
+
+// Verifies RiverCipher decrypts what it encrypted regardless of how the
+// message is split into calls, and that nonces result in different streams.
+static void VerifyRiverCipher() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const uint64_t nonce1[2] = {1, 0};
+  const uint64_t nonce2[2] = {0, 1};
+  const size_t kSize = 3 * SeekableRiver::kSegmentSize + 4321;
+  std::vector<uint8_t> plaintext(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    plaintext[i] = static_cast<uint8_t>(i * 0x9D + (i >> 11));
+  }
+
+  // Encrypt in one call, decrypt in calls of varying sizes.
+  std::vector<uint8_t> message = plaintext;
+  RiverCipher(key, nonce1).Crypt(message.data(), kSize);
+  std::vector<uint8_t> other_nonce = plaintext;
+  RiverCipher(key, nonce2).Crypt(other_nonce.data(), kSize);
+  std::vector<uint8_t> no_nonce = plaintext;
+  SeekableRiver(key).FillXor(no_nonce.data(), kSize);
+  if (message == plaintext || message == other_nonce || message == no_nonce) {
+    printf("RiverCipher nonce is ineffective\n");
+    exit(1);
+  }
+
+  RiverCipher decrypt(key, nonce1);
+  size_t pos = 0;
+  for (size_t size = 0; pos < kSize; size = size * 3 + 1) {
+    const size_t n = std::min(size, kSize - pos);
+    decrypt.Crypt(message.data() + pos, n);
+    pos += n;
+  }
+  if (message != plaintext) {
+    printf("RiverCipher decryption failed\n");
+    exit(1);
+  }
+
+  // Decrypting only part of the message.
+  RiverCipher(key, nonce1).Crypt(message.data(), kSize);
+  const size_t kBegin = SeekableRiver::kSegmentSize + 333;
+  RiverCipher range(key, nonce1);
+  range.Seek(kBegin);
+  range.Crypt(message.data() + kBegin, 1000);
+  if (memcmp(message.data() + kBegin, plaintext.data() + kBegin, 1000) != 0) {
+    printf("RiverCipher seek failed\n");
+    exit(1);
+  }
+  printf("Verified RiverCipher.\n");
+}
+
+// Verifies RiverEngine returns the words of consecutive River packets,
+// also after discard and Generate, and works with <random>.
+static void VerifyRiverEngine() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const size_t kWords = 5000;
+  std::vector<uint64_t> expected(kWords);
+  River river(key);
+  for (size_t pos = 0; pos < kWords; pos += 64) {
+    memcpy(&expected[pos], river.GeneratePseudoRandomData(),
+           std::min<size_t>(64, kWords - pos) * sizeof(uint64_t));
+  }
+
+  RiverEngine engine(key);
+  std::vector<uint64_t> out(kWords);
+  size_t pos = 0;
+  for (size_t step = 0; pos < kWords; ++step) {
+    const size_t num = std::min<size_t>((step * 37) % 300, kWords - pos);
+    switch (step % 3) {
+      case 0:
+        for (size_t i = 0; i < num; ++i) {
+          out[pos + i] = engine();
+        }
+        break;
+      case 1:
+        engine.discard(num);
+        memcpy(&out[pos], &expected[pos], num * sizeof(uint64_t));
+        break;
+      case 2:
+        engine.Generate(&out[pos], num);
+        break;
+    }
+    pos += num;
+  }
+  if (out != expected) {
+    printf("RiverEngine mismatch\n");
+    exit(1);
+  }
+
+  std::uniform_int_distribution<int> dist(0, 9);
+  std::vector<int> counts(10);
+  for (int i = 0; i < 10000; ++i) {
+    counts[dist(engine)]++;
+  }
+  std::shuffle(counts.begin(), counts.end(), engine);
+  for (const int count : counts) {
+    if (count < 850 || count > 1150) {
+      printf("RiverEngine distribution is skewed: %d\n", count);
+      exit(1);
+    }
+  }
+  printf("Verified RiverEngine.\n");
+}
+
+// Checks that "value" is within "tolerance" of "expected".
+static void VerifyNear(const char* caption, const double value,
+                       const double expected, const double tolerance) {
+  if (std::abs(value - expected) > tolerance) {
+    printf("%s: %f differs from %f\n", caption, value, expected);
+    exit(1);
+  }
+}
+
+// Verifies the range and moments of river_distributions.h generators.
+static void VerifyRiverDistributions() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  River river(key);
+  // Odd sizes also exercise the scalar remainder loops.
+  const size_t kNum = 1000003;
+
+  std::vector<double> doubles(kNum);
+  FillUniform(&river, doubles.data(), kNum);
+  double sum = 0.0;
+  for (const double d : doubles) {
+    if (!(d >= 0.0 && d < 1.0)) {
+      printf("Uniform double %f out of range\n", d);
+      exit(1);
+    }
+    sum += d;
+  }
+  VerifyNear("Uniform double mean", sum / kNum, 0.5, 0.002);
+
+  std::vector<float> floats(kNum);
+  FillUniform(&river, floats.data(), kNum);
+  sum = 0.0;
+  for (const float f : floats) {
+    if (!(f >= 0.0f && f < 1.0f)) {
+      printf("Uniform float %f out of range\n", f);
+      exit(1);
+    }
+    sum += f;
+  }
+  VerifyNear("Uniform float mean", sum / kNum, 0.5, 0.002);
+
+  // Small, non-power of two and large (frequent rejection) bounds.
+  const uint32_t bounds[] = {1, 10, 1000000007u, 3000000000u};
+  std::vector<uint32_t> bounded(kNum);
+  for (const uint32_t bound : bounds) {
+    FillBounded(&river, bound, bounded.data(), kNum);
+    std::vector<size_t> counts(10);
+    sum = 0.0;
+    for (const uint32_t value : bounded) {
+      if (value >= bound) {
+        printf("Bounded %u out of range %u\n", value, bound);
+        exit(1);
+      }
+      counts[static_cast<uint64_t>(value) * 10 / bound]++;
+      sum += value;
+    }
+    VerifyNear("Bounded mean", sum / kNum / bound, 0.5 - 0.5 / bound, 0.002);
+    for (int i = 0; i < 10 && bound >= 10; ++i) {
+      VerifyNear("Bounded histogram", counts[i] * 10.0 / kNum, 1.0, 0.02);
+    }
+  }
+
+  const double probabilities[] = {0.0, 0.5, 0.3, 1.0 / 3, 0.999, 1.0};
+  const size_t kNumMasks = 20001;
+  std::vector<uint64_t> masks(kNumMasks);
+  for (const double p : probabilities) {
+    FillBernoulli(&river, p, masks.data(), kNumMasks);
+    size_t ones = 0;
+    for (const uint64_t mask : masks) {
+      ones += __builtin_popcountll(mask);
+    }
+    VerifyNear("Bernoulli", double(ones) / (kNumMasks * 64), p, 0.002);
+  }
+
+  FillNormal(&river, doubles.data(), kNum);
+  double sum2 = 0.0;
+  size_t beyond3 = 0;
+  sum = 0.0;
+  for (const double d : doubles) {
+    sum += d;
+    sum2 += d * d;
+    beyond3 += std::abs(d) > 3.0;
+  }
+  VerifyNear("Normal mean", sum / kNum, 0.0, 0.005);
+  VerifyNear("Normal variance", sum2 / kNum, 1.0, 0.005);
+  VerifyNear("Normal tail", double(beyond3) / kNum, 0.0026998, 0.0003);
+
+  // Deterministic for a given River state.
+  River river1(key);
+  River river2(key);
+  std::vector<double> normals1(1000);
+  std::vector<double> normals2(1000);
+  FillNormal(&river1, normals1.data(), normals1.size());
+  FillNormal(&river2, normals2.data(), normals2.size());
+  if (normals1 != normals2) {
+    printf("FillNormal is not deterministic\n");
+    exit(1);
+  }
+  printf("Verified River distributions.\n");
+}
+
+// Verifies copies of River and RiverEngine continue the same stream, and
+// that forks are deterministic and differ from their parent.
+static void VerifyRiverCopy() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  River original(key);
+  uint8_t partial[100];
+  original.Fill(partial, sizeof(partial));
+
+  River copy(key);
+  copy = original;
+  River moved(std::move(River(original)));
+  uint8_t expected[1000];
+  uint8_t from_copy[1000];
+  uint8_t from_moved[1000];
+  original.Fill(expected, sizeof(expected));
+  copy.Fill(from_copy, sizeof(from_copy));
+  moved.Fill(from_moved, sizeof(from_moved));
+  if (memcmp(expected, from_copy, sizeof(expected)) != 0 ||
+      memcmp(expected, from_moved, sizeof(expected)) != 0) {
+    printf("River copy mismatch\n");
+    exit(1);
+  }
+
+  RiverEngine engine(key);
+  engine.discard(100);
+  RiverEngine engine_copy = engine;
+  for (int i = 0; i < 100; ++i) {
+    if (engine() != engine_copy()) {
+      printf("RiverEngine copy mismatch\n");
+      exit(1);
+    }
+  }
+
+  River parent1 = original;
+  River parent2 = original;
+  River child1 = parent1.Fork();
+  River child2 = parent2.Fork();
+  uint8_t from_child1[1000];
+  uint8_t from_child2[1000];
+  child1.Fill(from_child1, sizeof(from_child1));
+  child2.Fill(from_child2, sizeof(from_child2));
+  parent1.Fill(expected, sizeof(expected));
+  if (memcmp(from_child1, from_child2, sizeof(from_child1)) != 0 ||
+      memcmp(from_child1, expected, sizeof(expected)) == 0) {
+    printf("River fork mismatch\n");
+    exit(1);
+  }
+  printf("Verified River copy.\n");
+}
+
+// Verifies the AVX-512 River kernels produce the same packets and final
+// state as the AVX-2 kernels, starting from an arbitrary state.
+static void VerifyRiverKernels() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const size_t kWords = River::kStateWords;
+  std::vector<uint64_t> initial(2 * kWords);
+  River river(key);
+  river.Fill(reinterpret_cast<uint8_t*>(initial.data()),
+             initial.size() * sizeof(uint64_t));
+
+  const size_t kMaxPackets = 9;
+  const size_t kMaxSize = kMaxPackets * River::kPacketSize;
+  // One extra vector so that the output can also be misaligned.
+  std::vector<uint64_t> storage(2 * (kMaxSize / sizeof(uint64_t) + 8));
+  uint8_t* aligned = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+  uint8_t* expected = aligned;
+  uint8_t* actual = aligned + kMaxSize + 64;
+  for (size_t num_packets = 0; num_packets <= kMaxPackets; ++num_packets) {
+    const size_t size = num_packets * River::kPacketSize;
+    for (int variant = 0; variant < 4; ++variant) {
+      // Stream to aligned or misaligned output, store, or XOR.
+      const size_t misalign = variant == 1 ? 32 : 0;
+      std::vector<uint64_t> state2(initial.begin(), initial.begin() + kWords);
+      std::vector<uint64_t> state512 = state2;
+      memset(expected + misalign, 0x55, size);
+      memset(actual + misalign, 0x55, size);
+      if (variant == 3) {
+        AVX2RiverXor(state2.data(), num_packets, expected + misalign);
+        AVX512RiverXor(state512.data(), num_packets, actual + misalign);
+      } else {
+        const bool stream = variant != 2;
+        AVX2RiverCopy(state2.data(), num_packets, expected + misalign, stream);
+        AVX512RiverCopy(state512.data(), num_packets, actual + misalign,
+                        stream);
+      }
+      if (memcmp(expected + misalign, actual + misalign, size) != 0 ||
+          state2 != state512) {
+        printf("River AVX-512 mismatch: %zu packets, variant %d\n",
+               num_packets, variant);
+        exit(1);
+      }
+    }
+
+    // Two states at once must match two separate AVX-2 runs.
+    std::vector<uint64_t> state0(initial.begin(), initial.begin() + kWords);
+    std::vector<uint64_t> state1(initial.begin() + kWords, initial.end());
+    std::vector<uint64_t> pair0 = state0;
+    std::vector<uint64_t> pair1 = state1;
+    std::vector<uint8_t> expected1(size + 1);
+    std::vector<uint8_t> actual1(size + 1);
+    AVX2RiverCopy(state0.data(), num_packets, expected, false);
+    AVX2RiverCopy(state1.data(), num_packets, expected1.data(), false);
+    AVX512RiverCopy2(pair0.data(), pair1.data(), num_packets, actual,
+                     actual1.data(), num_packets % 2 == 0);
+    AVX2RiverXor(state0.data(), num_packets, expected);
+    AVX2RiverXor(state1.data(), num_packets, expected1.data());
+    AVX512RiverXor2(pair0.data(), pair1.data(), num_packets, actual,
+                    actual1.data());
+    if (memcmp(expected, actual, size) != 0 || expected1 != actual1 ||
+        state0 != pair0 || state1 != pair1) {
+      printf("River AVX-512 pair mismatch: %zu packets\n", num_packets);
+      exit(1);
+    }
+  }
+  printf("Verified River AVX-512.\n");
+}
+
+// Verifies each MultiRiver instance matches a standalone River, including
+// after an instance was used separately.
+static void VerifyMultiRiver() {
+  uint64_t keys[MultiRiver::kMaxInstances][8];
+  for (size_t k = 0; k < MultiRiver::kMaxInstances; ++k) {
+    for (int i = 0; i < 8; ++i) {
+      keys[k][i] = 0x0706050403020100ULL * (k + 1) + i;
+    }
+  }
+  const uint64_t* key_ptrs[MultiRiver::kMaxInstances] = {keys[0], keys[1],
+                                                         keys[2], keys[3]};
+  const size_t sizes[] = {0, 1, 100, 411, 512, 1000, 4096, 513, 3000};
+  const size_t kMaxSize = 4096;
+  for (size_t num = 1; num <= MultiRiver::kMaxInstances; ++num) {
+    MultiRiver multi(key_ptrs, num);
+    std::vector<River> rivers;
+    for (size_t k = 0; k < num; ++k) {
+      rivers.push_back(River(keys[k]));
+    }
+    std::vector<std::vector<uint8_t>> actual(num);
+    std::vector<uint8_t> expected(kMaxSize);
+    uint8_t* bytes[MultiRiver::kMaxInstances];
+    for (size_t k = 0; k < num; ++k) {
+      actual[k].resize(kMaxSize);
+      bytes[k] = actual[k].data();
+    }
+    for (int xor_stream = 0; xor_stream < 2; ++xor_stream) {
+      for (size_t size : sizes) {
+        for (size_t k = 0; k < num; ++k) {
+          memset(bytes[k], 0x55, size);
+        }
+        if (xor_stream) {
+          multi.FillXor(bytes, size);
+        } else {
+          multi.Fill(bytes, size);
+        }
+        for (size_t k = 0; k < num; ++k) {
+          memset(expected.data(), 0x55, size);
+          if (xor_stream) {
+            rivers[k].FillXor(expected.data(), size);
+          } else {
+            rivers[k].Fill(expected.data(), size);
+          }
+          if (memcmp(expected.data(), bytes[k], size) != 0) {
+            printf("MultiRiver mismatch: %zu instances, size %zu\n", num,
+                   size);
+            exit(1);
+          }
+        }
+      }
+      // Instance 0 leaves lockstep.
+      multi.Instance(0).Fill(expected.data(), 7);
+      rivers[0].Fill(expected.data(), 7);
+    }
+  }
+  printf("Verified MultiRiver.\n");
+}
+
+// Verifies a HighwayTreeHashBatch implementation matches HighwayTreeHash for
+// batches of inputs with differing lengths.
+template <class Function>
+static void VerifyBatch(const char* caption, const Function& batch_function) {
+  const int kMaxBatch = 9;
+  const int kMaxSize = 100;
+  ALIGNED(uint8_t, 64) in[kMaxBatch * kMaxSize];
+  for (size_t i = 0; i < sizeof(in); ++i) {
+    in[i] = static_cast<uint8_t>(i * 0x9D);
+  }
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+  for (int num = 1; num <= kMaxBatch; ++num) {
+    for (int seed = 0; seed < kMaxSize; ++seed) {
+      const uint8_t* bytes[kMaxBatch];
+      uint64_t sizes[kMaxBatch];
+      for (int i = 0; i < num; ++i) {
+        bytes[i] = in + i * kMaxSize;
+        sizes[i] = (seed + i * 37) % kMaxSize;
+      }
+      uint64_t hashes[kMaxBatch];
+      batch_function(key, bytes, sizes, num, hashes);
+      for (int i = 0; i < num; ++i) {
+        const uint64_t expected = HighwayTreeHash(key, bytes[i], sizes[i]);
+        if (hashes[i] != expected) {
+          printf("Failed for length %lu batch %d %lx %lx\n", sizes[i], num,
+                 hashes[i], expected);
+          exit(1);
+        }
+      }
+    }
+  }
+  printf("Verified %s.\n", caption);
+}
+
+// Verifies a SipHashBatch implementation matches SipHash for messages of
+// differing lengths.
+template <class Function>
+static void VerifySipHashBatch(const char* caption,
+                               const Function& batch_function) {
+  const int kMaxSize = 100;
+  ALIGNED(uint8_t, 64) in[4 * kMaxSize];
+  for (size_t i = 0; i < sizeof(in); ++i) {
+    in[i] = static_cast<uint8_t>(i * 0x9D);
+  }
+
+  const uint64_t key[2] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL};
+
+  for (int seed = 0; seed < kMaxSize * kMaxSize; ++seed) {
+    const uint8_t* bytes[4];
+    uint64_t sizes[4];
+    for (int i = 0; i < 4; ++i) {
+      bytes[i] = in + i * kMaxSize;
+      sizes[i] = (seed * (i + 1) + i * 37) % kMaxSize;
+    }
+    uint64_t hashes[4];
+    batch_function(key, bytes, sizes, hashes);
+    for (int i = 0; i < 4; ++i) {
+      const uint64_t expected = SipHash(key, bytes[i], sizes[i]);
+      if (hashes[i] != expected) {
+        printf("Failed for length %lu lane %d %lx %lx\n", sizes[i], i,
+               hashes[i], expected);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified %s.\n", caption);
+}
+
+// Verifies the HighwayTreeHashStream kernels of one instruction set against
+// the one-shot HighwayTreeHash, and (if available) their state against the
+// AVX-2 kernels after splitting the packets at odd points.
+template <class Reset, class Update, class Finalize>
+static void VerifyStreamKernels(const char* caption, const Reset& reset,
+                                const Update& update,
+                                const Finalize& finalize) {
+  const int kPacketSize = 32;
+  const int kMaxSize = 300;
+  ALIGNED(uint8_t, 64) in[kMaxSize];
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const bool avx2 = InstructionSets::Supported() & InstructionSets::kAVX2;
+
+  for (int size = 0; size < kMaxSize; ++size) {
+    in[size] = static_cast<uint8_t>(size);
+    const uint64_t expected = HighwayTreeHash(key, in, size);
+    const int num_packets = size / kPacketSize;
+    const int splits[] = {0, 1, 3, num_packets / 2 | 1, num_packets};
+    for (const int split : splits) {
+      if (split > num_packets) continue;
+      ALIGNED(uint64_t, 32) state[16];
+      ALIGNED(uint64_t, 32) reference[16];
+      reset(key, state);
+      update(in, split, state);
+      update(in + split * kPacketSize, num_packets - split, state);
+      if (avx2) {
+        AVX2HighwayTreeHashReset(key, reference);
+        AVX2HighwayTreeHashUpdate(in, num_packets, reference);
+      }
+      const uint64_t hash =
+          finalize(state, in + num_packets * kPacketSize, size);
+      if (hash != expected ||
+          (avx2 && memcmp(state, reference, sizeof(state)) != 0)) {
+        printf("%s failed for length %d split %d %lx %lx\n", caption, size,
+               split, hash, expected);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified %s.\n", caption);
+}
+
+// Same as VerifyStreamKernels, for the HighwayTreeHashStream512 kernels,
+// which never receive the final (possibly whole) packet in Update.
+template <class Reset, class Update, class Finalize>
+static void VerifyStreamKernels512(const char* caption, const Reset& reset,
+                                   const Update& update,
+                                   const Finalize& finalize) {
+  const int kPacketSize = 512;
+  const int kMaxSize = 2600;
+  ALIGNED(uint8_t, 64) in[kMaxSize];
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+  const bool avx2 = InstructionSets::Supported() & InstructionSets::kAVX2;
+
+  for (int size = 0; size < kMaxSize; ++size) {
+    in[size] = static_cast<uint8_t>(size);
+    ALIGNED(uint64_t, 64) expected[8];
+    HighwayTreeHash512(key, in, size, expected);
+    const int num_packets = size == 0 ? 0 : (size - 1) / kPacketSize;
+    const int remainder = size - num_packets * kPacketSize;
+    const int splits[] = {0, 1, 3, num_packets};
+    for (const int split : splits) {
+      if (split > num_packets) continue;
+      ALIGNED(uint64_t, 32) state[16];
+      ALIGNED(uint64_t, 32) reference[16];
+      reset(key, state);
+      update(in, split, state);
+      update(in + split * kPacketSize, num_packets - split, state);
+      if (avx2) {
+        AVX2HighwayTreeHash512Reset(key, reference);
+        AVX2HighwayTreeHash512Update(in, num_packets, reference);
+      }
+      ALIGNED(uint64_t, 64) hash[8];
+      finalize(state, in + num_packets * kPacketSize, remainder, hash);
+      if (memcmp(hash, expected, sizeof(hash)) != 0 ||
+          (avx2 && memcmp(state, reference, sizeof(state)) != 0)) {
+        printf("%s failed for length %d split %d %lx %lx\n", caption, size,
+               split, hash[0], expected[0]);
+        exit(1);
+      }
+    }
+  }
+  printf("Verified %s.\n", caption);
+}
+
 template <class Function>
 static void Benchmark(const char* caption, const Function& hash_function, const int size) {
   ALIGNED(uint8_t, 64) in[size];
@@ -230,6 +1166,704 @@ static void Benchmark512(const char* caption, const Function& hash_function, con
          cyclesPerByte);
 }
 
+// Reports nanoseconds per call of the dispatched HighwayTreeHash vs. calling
+// the kernel for the best instruction set directly. Small inputs expose the
+// cost of the indirect call.
+static void BenchmarkDispatch(const int size) {
+  ALIGNED(uint8_t, 64) in[64] = {0};
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+  uint64_t (*direct)(const uint64_t(&)[4], const uint8_t*, const uint64_t) =
+      ScalarHighwayTreeHash;
+  if (InstructionSets::Supported() & InstructionSets::kAVX2) {
+    direct = AVX2HighwayTreeHash;
+  }
+
+  const int kLoops = 200000;
+  uint64_t sum = 1;
+  uint64_t minTicks = 99999999999;
+  uint64_t minTicksDirect = 99999999999;
+  for (int rep = 0; rep < 25; ++rep) {
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      sum <<= 1;
+      sum ^= HighwayTreeHash(key, in, size);
+    }
+    const uint64_t t1 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      sum <<= 1;
+      sum ^= direct(key, in, size);
+    }
+    const uint64_t t2 = TimerTicks();
+    COMPILER_FENCE;
+    minTicks = std::min(minTicks, t1 - t0);
+    minTicksDirect = std::min(minTicksDirect, t2 - t1);
+  }
+  const double ns = minTicks * 1E9 / TimerFrequency() / kLoops;
+  const double nsDirect = minTicksDirect * 1E9 / TimerFrequency() / kLoops;
+  printf("%-28s %5d sum=0x%016lx\tns/call=%6.2f  direct ns/call=%.2f\n",
+         "HighwayTreeHash dispatch", size, sum, ns, nsDirect);
+}
+
+// Hashes 1 MiB in pieces of "fragment_size" bytes to measure the overhead
+// of HighwayTreeHashStream::Update relative to the one-shot function.
+static void BenchmarkStream(const size_t fragment_size) {
+  const size_t kSize = 1 << 20;
+  uint8_t* in = new uint8_t[kSize];
+  for (size_t i = 0; i < kSize; ++i) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+  uint64_t sum = 1;
+  uint64_t minTicks = 99999999999;
+  for (int rep = 0; rep < 25; ++rep) {
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    HighwayTreeHashStream stream(key);
+    for (size_t pos = 0; pos < kSize; pos += fragment_size) {
+      stream.Update(in + pos, std::min(fragment_size, kSize - pos));
+    }
+    sum <<= 1;
+    sum ^= stream.Finalize();
+    const uint64_t t1 = TimerTicks();
+    COMPILER_FENCE;
+    minTicks = std::min(minTicks, t1 - t0);
+  }
+  delete[] in;
+
+  const size_t num_updates = (kSize + fragment_size - 1) / fragment_size;
+  const double minSec = double(minTicks) / TimerFrequency();
+  const double nsPerUpdate = minSec * 1E9 / num_updates;
+  const double GBps = kSize / minSec * 1E-9;
+  printf("%-28s %5zu sum=0x%016lx\tGBps=%6.2f  ns/Update=%.2f\n",
+         "HighwayTreeHashStream", fragment_size, sum, GBps, nsPerUpdate);
+}
+
+// Reports nanoseconds per key for hashing "batch_size" keys of 8..40 bytes
+// via HighwayTreeHashBatch and via separate calls to HighwayTreeHash.
+static void BenchmarkBatch(const int batch_size) {
+  const int kMaxKeySize = 40;
+  ALIGNED(uint8_t, 64) in[256 * kMaxKeySize];
+  for (size_t i = 0; i < sizeof(in); ++i) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+  const uint8_t* keys[256];
+  uint64_t sizes[256];
+  for (int i = 0; i < batch_size; ++i) {
+    keys[i] = in + i * kMaxKeySize;
+    sizes[i] = 8 + (i * 7) % (kMaxKeySize - 8 + 1);
+  }
+
+  const uint64_t key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+  const int kLoops = 200000 / batch_size;
+  uint64_t sum = 1;
+  uint64_t minTicks = 99999999999;
+  uint64_t minTicksSingle = 99999999999;
+  for (int rep = 0; rep < 25; ++rep) {
+    uint64_t hashes[256];
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      HighwayTreeHashBatch(key, keys, sizes, batch_size, hashes);
+      sum <<= 1;
+      sum ^= hashes[batch_size - 1];
+    }
+    const uint64_t t1 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      for (int i = 0; i < batch_size; ++i) {
+        hashes[i] = HighwayTreeHash(key, keys[i], sizes[i]);
+      }
+      sum <<= 1;
+      sum ^= hashes[batch_size - 1];
+    }
+    const uint64_t t2 = TimerTicks();
+    COMPILER_FENCE;
+    minTicks = std::min(minTicks, t1 - t0);
+    minTicksSingle = std::min(minTicksSingle, t2 - t1);
+  }
+  const double num_keys = double(kLoops) * batch_size;
+  const double ns = minTicks * 1E9 / TimerFrequency() / num_keys;
+  const double nsSingle = minTicksSingle * 1E9 / TimerFrequency() / num_keys;
+  printf("%-28s %5d sum=0x%016lx\tns/key=%6.2f  single ns/key=%.2f\n",
+         "HighwayTreeHashBatch", batch_size, sum, ns, nsSingle);
+}
+
+// Reports throughput of SipHashBatch vs. four calls to SipHash for batches
+// of 8..64 byte messages with mixed lengths.
+static void BenchmarkSipHashBatch() {
+  const int kNumBatches = 64;
+  const int kMaxSize = 64;
+  ALIGNED(uint8_t, 64) in[4 * kNumBatches * kMaxSize];
+  for (size_t i = 0; i < sizeof(in); ++i) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+  const uint8_t* bytes[kNumBatches][4];
+  uint64_t sizes[kNumBatches][4];
+  uint64_t total_size = 0;
+  for (int batch = 0; batch < kNumBatches; ++batch) {
+    for (int i = 0; i < 4; ++i) {
+      bytes[batch][i] = in + (batch * 4 + i) * kMaxSize;
+      sizes[batch][i] = 8 + ((batch * 4 + i) * 23) % (kMaxSize - 8 + 1);
+      total_size += sizes[batch][i];
+    }
+  }
+
+  const uint64_t key[2] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL};
+
+  const int kLoops = 2000;
+  uint64_t sum = 1;
+  uint64_t minTicks = 99999999999;
+  uint64_t minTicksSingle = 99999999999;
+  for (int rep = 0; rep < 25; ++rep) {
+    uint64_t hashes[4];
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      for (int batch = 0; batch < kNumBatches; ++batch) {
+        SipHashBatch(key, bytes[batch], sizes[batch], hashes);
+        sum <<= 1;
+        sum ^= hashes[3];
+      }
+    }
+    const uint64_t t1 = TimerTicks();
+    COMPILER_FENCE;
+    for (int loop = 0; loop < kLoops; ++loop) {
+      for (int batch = 0; batch < kNumBatches; ++batch) {
+        for (int i = 0; i < 4; ++i) {
+          hashes[i] = SipHash(key, bytes[batch][i], sizes[batch][i]);
+        }
+        sum <<= 1;
+        sum ^= hashes[3];
+      }
+    }
+    const uint64_t t2 = TimerTicks();
+    COMPILER_FENCE;
+    minTicks = std::min(minTicks, t1 - t0);
+    minTicksSingle = std::min(minTicksSingle, t2 - t1);
+  }
+  const double minSec = double(minTicks) / TimerFrequency();
+  const double minSecSingle = double(minTicksSingle) / TimerFrequency();
+  const double GBps = kLoops * total_size / minSec * 1E-9;
+  const double GBpsSingle = kLoops * total_size / minSecSingle * 1E-9;
+  printf("%-28s 8..64 sum=0x%016lx\tGBps=%6.2f  single GBps=%.2f\n",
+         "SipHashBatch", sum, GBps, GBpsSingle);
+}
+
+// Reports the throughput of ParallelHighwayTreeHash512 for 256 MiB with
+// 1 to all hardware threads, with and without pinning.
+static void BenchmarkParallel() {
+  const uint64_t kSize = 256ULL << 20;
+  std::vector<uint8_t> in(kSize);
+  for (uint64_t i = 0; i < kSize; ++i) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+
+  const int max_threads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  for (int pin = 0; pin < 2; ++pin) {
+    for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+      ThreadPool pool(num_threads, pin != 0);
+      uint64_t sum = 1;
+      uint64_t minTicks = 99999999999;
+      for (int rep = 0; rep < 5; ++rep) {
+        const uint64_t t0 = TimerTicks();
+        COMPILER_FENCE;
+        uint64_t hash[8];
+        ParallelHighwayTreeHash512(key, in.data(), kSize, &pool, hash);
+        sum <<= 1;
+        sum ^= hash[0];
+        const uint64_t t1 = TimerTicks();
+        COMPILER_FENCE;
+        minTicks = std::min(minTicks, t1 - t0);
+      }
+      const double GBps = kSize / (double(minTicks) / TimerFrequency()) * 1E-9;
+      printf("%-28s %5d sum=0x%016lx\tGBps=%6.2f%s\n",
+             "ParallelHighwayTreeHash512", num_threads, sum, GBps,
+             pin ? "  pinned" : "");
+    }
+  }
+}
+
+// Reports the time to update HighwayMerkleTree after modifying 4 KiB of
+// 256 MiB, compared to rebuilding the tree.
+static void BenchmarkMerkleTree() {
+  const uint64_t kSize = 256ULL << 20;
+  std::vector<uint8_t> in(kSize);
+  for (uint64_t i = 0; i < kSize; ++i) {
+    in[i] = static_cast<uint8_t>(i);
+  }
+
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x2726252423222120ULL, 0x2F2E2D2C2B2A2928ULL,
+                           0x3736353433323130ULL, 0x3F3E3D3C3B3A3938ULL};
+
+  uint64_t t0 = TimerTicks();
+  HighwayMerkleTree tree(key, in.data(), kSize);
+  const double build_sec = double(TimerTicks() - t0) / TimerFrequency();
+
+  const int kUpdates = 1000;
+  uint64_t sum = 1;
+  t0 = TimerTicks();
+  COMPILER_FENCE;
+  for (int i = 0; i < kUpdates; ++i) {
+    // Unaligned, so it usually spans two chunks.
+    const uint64_t offset = (i * 7919ULL * 4096 + 1234) % (kSize - 4096);
+    in[offset] ^= 1;
+    tree.UpdateRange(in.data(), offset, 4096);
+    sum <<= 1;
+    sum ^= tree.Root()[0];
+  }
+  COMPILER_FENCE;
+  const double update_sec =
+      double(TimerTicks() - t0) / TimerFrequency() / kUpdates;
+  printf("%-28s       sum=0x%016lx\tbuild=%.3f s  4 KiB update=%.2f us\n",
+         "HighwayMerkleTree", sum, build_sec, update_sec * 1E6);
+}
+
+// Compares River::Fill and FillXor with copying GeneratePseudoRandomData
+// packets for a buffer that fits in L2 and one that does not.
+static void BenchmarkRiverFill(const size_t size) {
+  const ALIGNED(uint64_t, 64) key[8] = {
+      0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+      0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+      0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+      0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  std::vector<uint64_t> storage(size / sizeof(uint64_t) + 8);
+  uint8_t* out = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+
+  const char* names[3] = {"River memcpy", "River Fill", "River FillXor"};
+  for (int variant = 0; variant < 3; ++variant) {
+    River river(key);
+    uint64_t minTicks = 99999999999;
+    const int kReps = std::max<int>(5, (256 << 20) / size);
+    for (int rep = 0; rep < kReps; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      if (variant == 0) {
+        for (size_t pos = 0; pos < size; pos += River::kPacketSize) {
+          memcpy(out + pos, river.GeneratePseudoRandomData(),
+                 River::kPacketSize);
+        }
+      } else if (variant == 1) {
+        river.Fill(out, size);
+      } else {
+        river.FillXor(out, size);
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const double GBps = size / (double(minTicks) / TimerFrequency()) * 1E-9;
+    printf("%-28s %5zu KiB sum=0x%016x\tGBps=%6.2f\n", names[variant],
+           size >> 10, out[size - 1], GBps);
+  }
+}
+
+// Compares the River packet kernels on an L2-resident buffer. "AVX-512 x2"
+// advances two independent states (e.g. two SeekableRiver segments) at once
+// and reports their combined throughput.
+static void BenchmarkRiverKernels() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const size_t kSize = 128 << 10;
+  const size_t kPackets = kSize / River::kPacketSize;
+  std::vector<uint64_t> states(2 * River::kStateWords);
+  River river(key);
+  river.Fill(reinterpret_cast<uint8_t*>(states.data()),
+             states.size() * sizeof(uint64_t));
+  uint64_t* state0 = states.data();
+  uint64_t* state1 = states.data() + River::kStateWords;
+  std::vector<uint8_t> out0(kSize);
+  std::vector<uint8_t> out1(kSize);
+
+  const char* names[3] = {"River AVX-2", "River AVX-512", "River AVX-512 x2"};
+  for (int variant = 0; variant < 3; ++variant) {
+    if (variant != 0 &&
+        !(InstructionSets::Supported() & InstructionSets::kAVX512)) {
+      break;
+    }
+    uint64_t minTicks = 99999999999;
+    for (int rep = 0; rep < 500; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      if (variant == 0) {
+        AVX2RiverCopy(state0, kPackets, out0.data(), false);
+      } else if (variant == 1) {
+        AVX512RiverCopy(state0, kPackets, out0.data(), false);
+      } else {
+        AVX512RiverCopy2(state0, state1, kPackets, out0.data(), out1.data(),
+                         false);
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const size_t bytes = variant == 2 ? 2 * kSize : kSize;
+    const double GBps = bytes / (double(minTicks) / TimerFrequency()) * 1E-9;
+    printf("%-28s %5zu KiB sum=0x%016x\tGBps=%6.2f\n", names[variant],
+           kSize >> 10, out0[kSize - 1], GBps);
+  }
+}
+
+// Reports the cost of creating a River per session and generating "size"
+// bytes of keystream, individually and with MultiRiver.
+static void BenchmarkMultiRiver(const size_t size) {
+  const size_t kSessions = 4096;
+  std::vector<uint64_t> keys(kSessions * 8);
+  RiverEngine engine(keys.data());
+  engine.Generate(keys.data(), keys.size());
+  std::vector<uint8_t> out(MultiRiver::kMaxInstances * size);
+  uint8_t* bytes[MultiRiver::kMaxInstances];
+  for (size_t k = 0; k < MultiRiver::kMaxInstances; ++k) {
+    bytes[k] = out.data() + k * size;
+  }
+
+  const size_t group_sizes[3] = {1, 2, 4};
+  double ns_single = 0.0;
+  for (size_t group_size : group_sizes) {
+    uint64_t minTicks = 99999999999;
+    for (int rep = 0; rep < 10; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      for (size_t i = 0; i < kSessions; i += group_size) {
+        if (group_size == 1) {
+          River river(&keys[i * 8]);
+          river.Fill(out.data(), size);
+        } else {
+          const uint64_t* group_keys[MultiRiver::kMaxInstances];
+          for (size_t k = 0; k < group_size; ++k) {
+            group_keys[k] = &keys[(i + k) * 8];
+          }
+          MultiRiver multi(group_keys, group_size);
+          multi.Fill(bytes, size);
+        }
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const double ns = double(minTicks) / TimerFrequency() * 1E9 / kSessions;
+    if (group_size == 1) {
+      ns_single = ns;
+      printf("River per session      %5zu sum=0x%016x\tns/session=%7.1f\n",
+             size, out[size - 1], ns);
+    } else {
+      printf("MultiRiver x%zu          %5zu sum=0x%016x\tns/session=%7.1f"
+             "  speedup=%.2f\n",
+             group_size, size, out[size - 1], ns, ns_single / ns);
+    }
+  }
+}
+
+// Reports the throughput of sequential SeekableRiver::Fill and the latency
+// of seeking to a random offset and generating 4 KiB.
+static void BenchmarkSeekableRiver() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const size_t kSize = 64 << 20;
+  std::vector<uint64_t> storage(kSize / sizeof(uint64_t) + 8);
+  uint8_t* out = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+  SeekableRiver river(key);
+  uint64_t minTicks = 99999999999;
+  for (int rep = 0; rep < 5; ++rep) {
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    river.Fill(out, kSize);
+    COMPILER_FENCE;
+    const uint64_t t1 = TimerTicks();
+    minTicks = std::min(minTicks, t1 - t0);
+  }
+  const double GBps = kSize / (double(minTicks) / TimerFrequency()) * 1E-9;
+
+  const int kSeeks = 10000;
+  uint64_t sum = 1;
+  const uint64_t t0 = TimerTicks();
+  COMPILER_FENCE;
+  for (int i = 0; i < kSeeks; ++i) {
+    river.Seek((i * 0x9E3779B97F4A7C15ULL) >> 24);
+    river.Fill(out, 4096);
+    sum <<= 1;
+    sum ^= out[4095];
+  }
+  COMPILER_FENCE;
+  const double seek_us =
+      double(TimerTicks() - t0) / TimerFrequency() / kSeeks * 1E6;
+  printf("%-28s       sum=0x%016lx\tGBps=%6.2f  seek+4KiB=%.2f us\n",
+         "SeekableRiver", sum, GBps, seek_us);
+}
+
+// Reports the throughput of ParallelRiverFill for 256 MiB with 1 to all
+// hardware threads, with and without pinning.
+static void BenchmarkParallelRiver() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const size_t kSize = 256 << 20;
+  std::vector<uint64_t> storage(kSize / sizeof(uint64_t) + 8);
+  uint8_t* out = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(storage.data()) + 63) & ~uintptr_t(63));
+
+  const int max_threads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  for (int pin = 0; pin < 2; ++pin) {
+    for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+      ThreadPool pool(num_threads, pin != 0);
+      uint64_t minTicks = 99999999999;
+      for (int rep = 0; rep < 5; ++rep) {
+        const uint64_t t0 = TimerTicks();
+        COMPILER_FENCE;
+        ParallelRiverFill(key, 0, out, kSize, &pool);
+        COMPILER_FENCE;
+        const uint64_t t1 = TimerTicks();
+        minTicks = std::min(minTicks, t1 - t0);
+      }
+      const double GBps = kSize / (double(minTicks) / TimerFrequency()) * 1E-9;
+      printf("%-28s %5d sum=0x%016x\tGBps=%6.2f%s\n", "ParallelRiverFill",
+             num_threads, out[kSize - 1], GBps, pin ? "  pinned" : "");
+    }
+  }
+}
+
+// Compares RiverCipher::Crypt with generating the keystream into a buffer
+// and then XORing it into the message.
+static void BenchmarkRiverCipher(const size_t size) {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const uint64_t nonce[2] = {1, 2};
+  std::vector<uint8_t> message(size);
+  std::vector<uint8_t> keystream(size);
+
+  const char* names[2] = {"RiverCipher", "SeekableRiver Fill+XOR"};
+  for (int variant = 0; variant < 2; ++variant) {
+    uint64_t minTicks = 99999999999;
+    const int kReps = std::max<int>(5, (256 << 20) / size);
+    for (int rep = 0; rep < kReps; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      if (variant == 0) {
+        RiverCipher(key, nonce).Crypt(message.data(), size);
+      } else {
+        SeekableRiver(key, nonce).Fill(keystream.data(), size);
+        for (size_t i = 0; i < size; ++i) {
+          message[i] ^= keystream[i];
+        }
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const double GBps = size / (double(minTicks) / TimerFrequency()) * 1E-9;
+    printf("%-28s %5zu KiB sum=0x%016x\tGBps=%6.2f\n", names[variant],
+           size >> 10, message[size - 1], GBps);
+  }
+}
+
+static void GenerateWords(RiverEngine& engine, uint64_t* words, size_t num) {
+  engine.Generate(words, num);
+}
+
+static void GenerateWords(std::mt19937_64& engine, uint64_t* words,
+                          size_t num) {
+  std::generate(words, words + num, std::ref(engine));
+}
+
+// Reports the time per word of RiverEngine and std::mt19937_64 for single
+// calls, uniform_int_distribution and bulk generation of 1 MiB.
+template <class Engine>
+static void BenchmarkEngine(const char* name, Engine& engine) {
+  const size_t kWords = 128 * 1024;
+  std::vector<uint64_t> words(kWords);
+  std::uniform_int_distribution<uint32_t> dist(0, 999999);
+  for (int variant = 0; variant < 3; ++variant) {
+    uint64_t sum = 1;
+    uint64_t minTicks = 99999999999;
+    for (int rep = 0; rep < 20; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      if (variant == 0) {
+        for (size_t i = 0; i < kWords; ++i) {
+          sum += engine();
+        }
+      } else if (variant == 1) {
+        for (size_t i = 0; i < kWords; ++i) {
+          sum += dist(engine);
+        }
+      } else {
+        GenerateWords(engine, words.data(), kWords);
+        sum += words[kWords - 1];
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const char* variants[3] = {"single", "uniform_int", "bulk"};
+    const double ns = double(minTicks) / TimerFrequency() / kWords * 1E9;
+    printf("%-28s %-11s sum=0x%016lx\tns/word=%5.2f\n", name,
+           variants[variant], sum, ns);
+  }
+}
+
+static void BenchmarkRiverEngine() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  RiverEngine river_engine(key);
+  BenchmarkEngine("RiverEngine", river_engine);
+  std::mt19937_64 mt_engine(12345);
+  BenchmarkEngine("mt19937_64", mt_engine);
+}
+
+// Reports ns per value of river_distributions.h generators and the
+// corresponding <random> distribution using RiverEngine.
+static void BenchmarkRiverDistributions() {
+  const uint64_t key[8] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL,
+                           0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const size_t kNum = 64 * 1024;
+  std::vector<double> doubles(kNum);
+  std::vector<float> floats(kNum);
+  std::vector<uint32_t> bounded(kNum);
+  std::vector<uint64_t> masks(kNum / 64);
+  River river(key);
+  RiverEngine engine(key);
+  std::uniform_real_distribution<double> uniform_double;
+  std::uniform_real_distribution<float> uniform_float;
+  std::uniform_int_distribution<uint32_t> uniform_int(0, 999999);
+  std::bernoulli_distribution bernoulli(0.3);
+  std::normal_distribution<double> normal;
+
+  const char* names[10] = {
+      "FillUniform double", "uniform_real<double>", "FillUniform float",
+      "uniform_real<float>", "FillBounded", "uniform_int",
+      "FillBernoulli 0.3", "bernoulli 0.3", "FillNormal", "normal"};
+  for (int variant = 0; variant < 10; ++variant) {
+    uint64_t minTicks = 99999999999;
+    for (int rep = 0; rep < 20; ++rep) {
+      const uint64_t t0 = TimerTicks();
+      COMPILER_FENCE;
+      switch (variant) {
+        case 0:
+          FillUniform(&river, doubles.data(), kNum);
+          break;
+        case 1:
+          for (double& d : doubles) d = uniform_double(engine);
+          break;
+        case 2:
+          FillUniform(&river, floats.data(), kNum);
+          break;
+        case 3:
+          for (float& f : floats) f = uniform_float(engine);
+          break;
+        case 4:
+          FillBounded(&river, 1000000, bounded.data(), kNum);
+          break;
+        case 5:
+          for (uint32_t& u : bounded) u = uniform_int(engine);
+          break;
+        case 6:
+          FillBernoulli(&river, 0.3, masks.data(), masks.size());
+          break;
+        case 7:
+          for (size_t i = 0; i < kNum; ++i) {
+            masks[i / 64] = (masks[i / 64] << 1) | bernoulli(engine);
+          }
+          break;
+        case 8:
+          FillNormal(&river, doubles.data(), kNum);
+          break;
+        case 9:
+          for (double& d : doubles) d = normal(engine);
+          break;
+      }
+      COMPILER_FENCE;
+      const uint64_t t1 = TimerTicks();
+      minTicks = std::min(minTicks, t1 - t0);
+    }
+    const double ns = double(minTicks) / TimerFrequency() / kNum * 1E9;
+    const uint64_t sum = static_cast<uint64_t>(doubles[1] * 1E9) ^
+                         static_cast<uint64_t>(floats[1] * 1E9) ^
+                         bounded[1] ^ masks[1];
+    printf("%-28s       sum=0x%016lx\tns/value=%5.2f\n", names[variant], sum,
+           ns);
+  }
+}
+
+// River with the footprint of its previous implementation (8.7 KB).
+struct PaddedRiver {
+  explicit PaddedRiver(const uint64_t* key) : river(key) {}
+  River river;
+  uint8_t padding[(River::kPacketSize + 16 * 32 + 64) * sizeof(uint64_t) -
+                  sizeof(River)];
+};
+
+static River& GetRiver(River& river) { return river; }
+static River& GetRiver(PaddedRiver& padded) { return padded.river; }
+
+// Reports the time per 64-byte Fill from 100k Rivers in random order, as in
+// a server with one River per session.
+template <class Session>
+static void BenchmarkRiverSessions(const char* caption) {
+  const size_t kSessions = 100000;
+  std::vector<Session> sessions;
+  sessions.reserve(kSessions);
+  uint64_t key[8] = {0};
+  for (size_t i = 0; i < kSessions; ++i) {
+    key[0] = i;
+    sessions.emplace_back(key);
+  }
+  std::vector<uint32_t> order(kSessions);
+  for (size_t i = 0; i < kSessions; ++i) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(123));
+
+  uint64_t sum = 1;
+  uint64_t minTicks = 99999999999;
+  for (int rep = 0; rep < 5; ++rep) {
+    const uint64_t t0 = TimerTicks();
+    COMPILER_FENCE;
+    for (const uint32_t session : order) {
+      uint64_t out[8];
+      GetRiver(sessions[session]).Fill(reinterpret_cast<uint8_t*>(out),
+                                       sizeof(out));
+      sum += out[0];
+    }
+    COMPILER_FENCE;
+    const uint64_t t1 = TimerTicks();
+    minTicks = std::min(minTicks, t1 - t0);
+  }
+  const double ns = double(minTicks) / TimerFrequency() / kSessions * 1E9;
+  printf("%-28s %5zu sum=0x%016lx\tns/Fill(64)=%6.1f\n", caption,
+         sizeof(Session), sum, ns);
+}
+
 static void BenchmarkRiver() {
   const ALIGNED(uint64_t, 64) key[8] = {
       0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
@@ -276,17 +1910,89 @@ int main(int argc, char* argv[]) {
   }
   Benchmark("ScalarSipTreeHash", ScalarSipTreeHash, size);
   Benchmark("ScalarHighwayTreeHash", ScalarHighwayTreeHash, size);
-  //Benchmark("ScalarHighwayTreeHash512", ScalarHighwayTreeHash512, size);
+  Benchmark512("ScalarHighwayTreeHash512", ScalarHighwayTreeHash512, size);
   Benchmark("SipHash", SipHash, size);
   Benchmark("SipTreeHash", SipTreeHash, size);
   Benchmark("HighwayTreeHash", HighwayTreeHash, size);
+  if (InstructionSets::Supported() & InstructionSets::kSSE41) {
+    Benchmark("SSE41HighwayTreeHash", SSE41HighwayTreeHash, size);
+  }
   Benchmark512("HighwayTreeHash512", HighwayTreeHash512, size);
-  BenchmarkRiver();
+  BenchmarkDispatch(0);
+  BenchmarkDispatch(8);
+  BenchmarkDispatch(31);
+  BenchmarkStream(1);
+  BenchmarkStream(64);
+  BenchmarkStream(1500);
+  BenchmarkStream(65536);
+  BenchmarkBatch(1);
+  BenchmarkBatch(4);
+  BenchmarkBatch(16);
+  BenchmarkBatch(256);
+  BenchmarkSipHashBatch();
+  BenchmarkParallel();
+  BenchmarkMerkleTree();
+  if (River::Supported()) {
+    BenchmarkRiver();
+    BenchmarkRiverFill(256 << 10);
+    BenchmarkRiverFill(64 << 20);
+    BenchmarkRiverKernels();
+    BenchmarkSeekableRiver();
+    BenchmarkParallelRiver();
+    BenchmarkRiverCipher(16 << 10);
+    BenchmarkRiverCipher(64 << 20);
+    BenchmarkRiverEngine();
+    BenchmarkRiverDistributions();
+    BenchmarkRiverSessions<River>("River sessions");
+    BenchmarkRiverSessions<PaddedRiver>("River sessions 8.7 KB");
+    BenchmarkMultiRiver(64);
+    BenchmarkMultiRiver(1024);
+    BenchmarkMultiRiver(4096);
+  }
 
   VerifySipHash();
+  VerifySipHashBatch("SipHash batch", SipHashBatch);
+  VerifySipHashBatch("SipHash batch scalar", ScalarSipHashBatch);
+  VerifyEqual("SipHash scalar", SipHash, ScalarSipHash);
   VerifyEqual("SipTree scalar", SipTreeHash, ScalarSipTreeHash);
+  VerifyStream();
+  VerifyStream512();
+  VerifyBatch("HighwayTree batch", HighwayTreeHashBatch);
+  VerifyBatch("HighwayTree batch scalar", ScalarHighwayTreeHashBatch);
+  VerifyStreamKernels("HighwayTree stream scalar", ScalarHighwayTreeHashReset,
+                      ScalarHighwayTreeHashUpdate,
+                      ScalarHighwayTreeHashFinalize);
+  VerifyStreamKernels512("HighwayTree512 stream scalar",
+                         ScalarHighwayTreeHash512Reset,
+                         ScalarHighwayTreeHash512Update,
+                         ScalarHighwayTreeHash512Finalize);
+  if (InstructionSets::Supported() & InstructionSets::kSSE41) {
+    VerifyBatch("HighwayTree batch SSE4.1", SSE41HighwayTreeHashBatch);
+    VerifyStreamKernels("HighwayTree stream SSE4.1",
+                        SSE41HighwayTreeHashReset, SSE41HighwayTreeHashUpdate,
+                        SSE41HighwayTreeHashFinalize);
+  }
+  VerifyParallel();
+  VerifyMerkleTree();
+  if (River::Supported()) {
+    VerifyRiverFill();
+    VerifySeekableRiver();
+    VerifyParallelRiver();
+    VerifyRiverCipher();
+    VerifyRiverEngine();
+    VerifyRiverDistributions();
+    VerifyRiverCopy();
+    VerifyMultiRiver();
+  }
+  if (InstructionSets::Supported() & InstructionSets::kAVX512) {
+    VerifyRiverKernels();
+  }
   VerifyEqual("HighwayTree scalar", HighwayTreeHash, ScalarHighwayTreeHash);
-  //VerifyEqual("HighwayTree512 scalar", HighwayTreeHash512, ScalarHighwayTreeHash512);
+  if (InstructionSets::Supported() & InstructionSets::kSSE41) {
+    VerifyEqual("HighwayTree SSE4.1", HighwayTreeHash, SSE41HighwayTreeHash);
+  }
+  VerifyEqual512("HighwayTree512 scalar", HighwayTreeHash512,
+                 ScalarHighwayTreeHash512);
 
   return 0;
 }
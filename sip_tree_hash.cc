@@ -12,10 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "sip_tree_hash.h"
+#include "dispatch.h"
 
 #include <cstring>  // memcpy
-#include "sip_hash.h"
 #include "vec2.h"
 
 namespace {
@@ -157,8 +156,8 @@ static INLINE V4x64U LoadFinalPacket32(const uint8_t* bytes,
 
 }  // namespace
 
-uint64_t SipTreeHash(const uint64_t (&key)[kNumLanes], const uint8_t* bytes,
-                     const uint64_t size) {
+uint64_t AVX2SipTreeHash(const uint64_t (&key)[kNumLanes],
+                         const uint8_t* bytes, const uint64_t size) {
   SipTreeHashState state(key);
 
   const size_t remainder = size & (kPacketSize - 1);
@@ -178,5 +177,5 @@ uint64_t SipTreeHash(const uint64_t (&key)[kNumLanes], const uint8_t* bytes,
   ALIGNED(uint64_t, 64) hashes[kNumLanes];
   Store(state.Finalize(), hashes);
 
-  return ReduceSipTreeHash(key, hashes);
+  return AVX2ReduceSipTreeHash(key, hashes);
 }
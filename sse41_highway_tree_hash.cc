@@ -0,0 +1,199 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "dispatch.h"
+
+#include <cstring>  // memcpy
+#include "vec.h"
+
+namespace {
+
+// Same algorithm as HighwayTreeHashState in highway_tree_hash.cc for CPUs
+// without AVX-2. Each 256-bit vector is split into lower (L) and upper (H)
+// 128-bit halves. All operations except Permute act within 128-bit halves,
+// so the halves are updated independently.
+const int kNumLanes = 4;
+const int kPacketSize = kNumLanes * sizeof(uint64_t);
+
+class SSE41HighwayTreeHashState {
+ public:
+  explicit INLINE SSE41HighwayTreeHashState(
+      const uint64_t (&keys)[kNumLanes]) {
+    const V2x64U init0L(0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
+    const V2x64U init0H(0x243f6a8885a308d3ull, 0x13198a2e03707344ull);
+    const V2x64U init1L(0xc0acf169b5f18a8cull, 0x3bd39e10cb0ef593ull);
+    const V2x64U init1H(0x452821e638d01377ull, 0xbe5466cf34e90c6cull);
+    const V2x64U keyL = LoadU(keys + 0);
+    const V2x64U keyH = LoadU(keys + 2);
+    v0L = keyL ^ init0L;
+    v0H = keyH ^ init0H;
+    // Permute swaps the halves.
+    v1L = Rotate32(keyH) ^ init1L;
+    v1H = Rotate32(keyL) ^ init1H;
+    mul0L = init0L;
+    mul0H = init0H;
+    mul1L = init1L;
+    mul1H = init1H;
+  }
+
+  // Leaves the state uninitialized; used together with Restore.
+  INLINE SSE41HighwayTreeHashState() {}
+
+  // Same layout as HighwayTreeHashState::Save.
+  INLINE void Save(uint64_t* RESTRICT words) const {
+    StoreU(v0L, words + 0);
+    StoreU(v0H, words + 2);
+    StoreU(v1L, words + 4);
+    StoreU(v1H, words + 6);
+    StoreU(mul0L, words + 8);
+    StoreU(mul0H, words + 10);
+    StoreU(mul1L, words + 12);
+    StoreU(mul1H, words + 14);
+  }
+
+  INLINE void Restore(const uint64_t* RESTRICT words) {
+    v0L = LoadU(words + 0);
+    v0H = LoadU(words + 2);
+    v1L = LoadU(words + 4);
+    v1H = LoadU(words + 6);
+    mul0L = LoadU(words + 8);
+    mul0H = LoadU(words + 10);
+    mul1L = LoadU(words + 12);
+    mul1H = LoadU(words + 14);
+  }
+
+  INLINE void Update(const V2x64U& packetL, const V2x64U& packetH) {
+    UpdateHalf(packetL, &v0L, &v1L, &mul0L, &mul1L);
+    UpdateHalf(packetH, &v0H, &v1H, &mul0H, &mul1H);
+  }
+
+  INLINE uint64_t Finalize() {
+    // Mix together all lanes.
+    PermuteAndUpdate();
+    PermuteAndUpdate();
+    PermuteAndUpdate();
+    PermuteAndUpdate();
+
+    return _mm_cvtsi128_si64(v0L + v1L + mul0L + mul1L);
+  }
+
+ private:
+  static INLINE void UpdateHalf(const V2x64U& packet, V2x64U* RESTRICT v0,
+                                V2x64U* RESTRICT v1, V2x64U* RESTRICT mul0,
+                                V2x64U* RESTRICT mul1) {
+    *v1 += packet;
+    *v1 += *mul0;
+    *mul0 ^= V2x64U(_mm_mul_epu32(*v0, *v1 >> 32));
+    *v0 += *mul1;
+    *mul1 ^= V2x64U(_mm_mul_epu32(*v1, *v0 >> 32));
+    *v0 += ZipperMerge(*v1);
+    *v1 += ZipperMerge(*v0);
+  }
+
+  static INLINE V2x64U ZipperMerge(const V2x64U& v) {
+    // See HighwayTreeHashState::ZipperMerge.
+    const uint64_t hi = 0x070806090D0A040Bull;
+    const uint64_t lo = 0x000F010E05020C03ull;
+    return V2x64U(_mm_shuffle_epi8(v, V2x64U(hi, lo)));
+  }
+
+  // Swaps the 32-bit halves of each lane.
+  static INLINE V2x64U Rotate32(const V2x64U& v) {
+    return V2x64U(_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+
+  // Permute (swapping the 128-bit halves and 32-bit halves) then Update.
+  INLINE void PermuteAndUpdate() {
+    Update(Rotate32(v0H), Rotate32(v0L));
+  }
+
+  V2x64U v0L;
+  V2x64U v0H;
+  V2x64U v1L;
+  V2x64U v1H;
+  V2x64U mul0L;
+  V2x64U mul0H;
+  V2x64U mul1L;
+  V2x64U mul1H;
+};
+
+// Updates "state" with the final packet: the remaining 0..31 bytes, with
+// the lower 8 bits of "size" in the upper byte and zeros in between.
+// SSE4.1 has no masked loads, so the bytes are copied to a buffer.
+static INLINE void UpdateFinalPacket(const uint8_t* bytes, const uint64_t size,
+                                     SSE41HighwayTreeHashState* state) {
+  const size_t remainder = size & (kPacketSize - 1);
+  const size_t remainder_mod4 = remainder & 3;
+  uint32_t packet4 = static_cast<uint32_t>(size) << 24;
+  const uint8_t* final_bytes = bytes + remainder - remainder_mod4;
+  for (size_t i = 0; i < remainder_mod4; ++i) {
+    packet4 += static_cast<uint32_t>(final_bytes[i]) << (i * 8);
+  }
+
+  ALIGNED(uint64_t, 16) packet[kNumLanes] = {0};
+  memcpy(packet, bytes, remainder - remainder_mod4);
+  memcpy(reinterpret_cast<uint8_t*>(packet) + kPacketSize - 4, &packet4,
+         sizeof(packet4));
+  state->Update(Load(packet + 0), Load(packet + 2));
+}
+
+}  // namespace
+
+uint64_t SSE41HighwayTreeHash(const uint64_t (&key)[kNumLanes],
+                              const uint8_t* bytes, const uint64_t size) {
+  SSE41HighwayTreeHashState state(key);
+
+  const size_t remainder = size & (kPacketSize - 1);
+  const size_t truncated_size = size - remainder;
+  const uint64_t* packets = reinterpret_cast<const uint64_t*>(bytes);
+  for (size_t i = 0; i < truncated_size / sizeof(uint64_t); i += kNumLanes) {
+    state.Update(LoadU(packets + i), LoadU(packets + i + 2));
+  }
+
+  UpdateFinalPacket(bytes + truncated_size, size, &state);
+  return state.Finalize();
+}
+
+void SSE41HighwayTreeHashBatch(const uint64_t (&key)[kNumLanes],
+                               const uint8_t* const* bytes,
+                               const uint64_t* sizes, const uint64_t num,
+                               uint64_t* hashes) {
+  for (uint64_t i = 0; i < num; ++i) {
+    hashes[i] = SSE41HighwayTreeHash(key, bytes[i], sizes[i]);
+  }
+}
+
+void SSE41HighwayTreeHashReset(const uint64_t (&key)[kNumLanes],
+                               uint64_t* state) {
+  SSE41HighwayTreeHashState(key).Save(state);
+}
+
+void SSE41HighwayTreeHashUpdate(const uint8_t* packets,
+                                const uint64_t num_packets, uint64_t* state) {
+  SSE41HighwayTreeHashState resumed;
+  resumed.Restore(state);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(packets);
+  for (uint64_t i = 0; i < num_packets * kNumLanes; i += kNumLanes) {
+    resumed.Update(LoadU(words + i), LoadU(words + i + 2));
+  }
+  resumed.Save(state);
+}
+
+uint64_t SSE41HighwayTreeHashFinalize(const uint64_t* state,
+                                      const uint8_t* final_bytes,
+                                      const uint64_t size) {
+  SSE41HighwayTreeHashState resumed;
+  resumed.Restore(state);
+  UpdateFinalPacket(final_bytes, size, &resumed);
+  return resumed.Finalize();
+}
@@ -0,0 +1,127 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Binds the calling thread to the index-th CPU in the process's affinity
+// mask (which honors taskset and cgroup limits).
+void PinCurrentThread(const int index) {
+#ifdef __linux__
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+  const int num_allowed = CPU_COUNT(&allowed);
+  if (num_allowed == 0) {
+    return;
+  }
+  int remaining = index % num_allowed;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    if (remaining-- == 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      return;
+    }
+  }
+#else
+  (void)index;
+#endif
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(const int num_threads, const bool pin_threads)
+    : pin_threads_(pin_threads), next_task_(0) {
+  for (int thread = 0; thread < num_threads; ++thread) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, thread);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  work_ready_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Run(const uint64_t num_tasks, const Task& task) {
+  if (num_tasks == 0) return;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  num_tasks_ = num_tasks;
+  next_task_.store(0, std::memory_order_relaxed);
+  num_busy_ = NumThreads();
+  ++generation_;
+  work_ready_.notify_all();
+  work_done_.wait(lock, [this] { return num_busy_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(const int thread) {
+  if (pin_threads_) {
+    PinCurrentThread(thread);
+  }
+
+  uint64_t seen_generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this, seen_generation] {
+        return exit_ || generation_ != seen_generation;
+      });
+      if (exit_) return;
+      seen_generation = generation_;
+    }
+
+    RunTasks(thread);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_busy_ == 0) {
+      work_done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunTasks(const int thread) {
+  if (pin_threads_) {
+    // Contiguous range per worker: [begin, end).
+    const uint64_t num_threads = NumThreads();
+    const uint64_t begin = num_tasks_ * thread / num_threads;
+    const uint64_t end = num_tasks_ * (thread + 1) / num_threads;
+    for (uint64_t i = begin; i < end; ++i) {
+      (*task_)(i, thread);
+    }
+    return;
+  }
+
+  for (;;) {
+    const uint64_t i = next_task_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= num_tasks_) return;
+    (*task_)(i, thread);
+  }
+}
@@ -0,0 +1,69 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_THREAD_POOL_H_
+#define HIGHWAYHASH_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run numbered tasks in parallel. Creating
+// threads is expensive, so a pool should be reused across calls to Run.
+class ThreadPool {
+ public:
+  // Called with the task number and the index of the worker thread.
+  using Task = std::function<void(uint64_t task, int thread)>;
+
+  // Starts "num_threads" (>= 1) workers. If "pin_threads", worker i is bound
+  // to the i-th CPU the process may run on (Linux only) and Run assigns each
+  // worker a contiguous range of tasks. Together with first-touch page
+  // placement, this keeps each worker's memory on its NUMA node, provided the
+  // data was written by a Run with the same number of tasks. Otherwise tasks
+  // are handed out dynamically to balance the load.
+  explicit ThreadPool(const int num_threads, const bool pin_threads = false);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int NumThreads() const { return static_cast<int>(workers_.size()); }
+
+  // Calls task(i, thread) for all i < num_tasks and returns when all have
+  // finished. Not reentrant: only one thread may call Run at a time.
+  void Run(const uint64_t num_tasks, const Task& task);
+
+ private:
+  void WorkerLoop(const int thread);
+  void RunTasks(const int thread);
+
+  const bool pin_threads_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+  uint64_t generation_ = 0;  // Incremented by each Run.
+  int num_busy_ = 0;         // Workers still running tasks of this Run.
+  bool exit_ = false;
+
+  const Task* task_ = nullptr;
+  uint64_t num_tasks_ = 0;
+  std::atomic<uint64_t> next_task_;
+};
+
+#endif  // #ifndef HIGHWAYHASH_THREAD_POOL_H_
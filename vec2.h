@@ -34,7 +34,7 @@
 #include "code_annotation.h"
 
 class V4x64U_cl;
-typedef ALIGNED(V4x64U_cl, 64) V4x64U;
+typedef ALIGNED(V4x64U_cl, 32) V4x64U;
 
 // 256-bit AVX-2 vector with 4 uint64_t lanes.
 class V4x64U_cl {
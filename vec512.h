@@ -0,0 +1,197 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HIGHWAYHASH_VEC512_H_
+#define HIGHWAYHASH_VEC512_H_
+
+#include <stdio.h>
+
+// Defines a 512-bit vector class ("V8x64U") with the same interface as
+// V4x64U in vec2.h.
+//
+// Requires reasonable C++11 support (VC2015) and an AVX-512F/BW-capable CPU.
+
+// GCC 12 warns about the deliberately undefined inputs of some AVX-512
+// intrinsics (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=105593).
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#include <cstdint>
+#include "code_annotation.h"
+
+class V8x64U_cl;
+typedef ALIGNED(V8x64U_cl, 64) V8x64U;
+
+// 512-bit AVX-512 vector with 8 uint64_t lanes.
+class V8x64U_cl {
+ public:
+  using T = uint64_t;
+  static constexpr size_t kNumLanes = sizeof(__m512i) / sizeof(T);
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  INLINE V8x64U_cl() {}
+
+  // Lane 0 (p_0) is the lowest.
+  INLINE V8x64U_cl(T p_7, T p_6, T p_5, T p_4, T p_3, T p_2, T p_1, T p_0)
+      : v_(_mm512_set_epi64(p_7, p_6, p_5, p_4, p_3, p_2, p_1, p_0)) {}
+
+  // Broadcasts i to all lanes.
+  INLINE explicit V8x64U_cl(T i) : v_(_mm512_set1_epi64(i)) {}
+
+  // Converts to/from intrinsics.
+  INLINE explicit V8x64U_cl(const __m512i& v) : v_(v) {}
+  INLINE operator __m512i() const { return v_; }
+  INLINE V8x64U& operator=(const __m512i& v) {
+    v_ = v;
+    return *this;
+  }
+
+  INLINE V8x64U& operator=(const V8x64U& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  INLINE V8x64U& operator+=(const V8x64U& other) {
+    v_ = _mm512_add_epi64(v_, other);
+    return *this;
+  }
+  INLINE V8x64U& operator-=(const V8x64U& other) {
+    v_ = _mm512_sub_epi64(v_, other);
+    return *this;
+  }
+
+  INLINE V8x64U& operator&=(const V8x64U& other) {
+    v_ = _mm512_and_si512(v_, other);
+    return *this;
+  }
+  INLINE V8x64U& operator|=(const V8x64U& other) {
+    v_ = _mm512_or_si512(v_, other);
+    return *this;
+  }
+  INLINE V8x64U& operator^=(const V8x64U& other) {
+    v_ = _mm512_xor_si512(v_, other);
+    return *this;
+  }
+
+  INLINE V8x64U& operator<<=(const int count) {
+    v_ = _mm512_slli_epi64(v_, count);
+    return *this;
+  }
+
+  INLINE V8x64U& operator>>=(const int count) {
+    v_ = _mm512_srli_epi64(v_, count);
+    return *this;
+  }
+
+  void print(const char *name) const {
+    const uint64_t *p = reinterpret_cast<const uint64_t*>(&v_);
+    printf("%s = %016lx%016lx%016lx%016lx%016lx%016lx%016lx%016lx\n", name,
+           p[7], p[6], p[5], p[4], p[3], p[2], p[1], p[0]);
+  }
+
+ private:
+  __m512i v_;
+};
+
+// Nonmember functions implemented in terms of member functions
+
+static INLINE V8x64U operator+(const V8x64U& left, const V8x64U& right) {
+  V8x64U t(left);
+  return t += right;
+}
+
+static INLINE V8x64U operator-(const V8x64U& left, const V8x64U& right) {
+  V8x64U t(left);
+  return t -= right;
+}
+
+static INLINE V8x64U operator<<(const V8x64U& v, const int count) {
+  V8x64U t(v);
+  return t <<= count;
+}
+
+static INLINE V8x64U operator>>(const V8x64U& v, const int count) {
+  V8x64U t(v);
+  return t >>= count;
+}
+
+static INLINE V8x64U operator&(const V8x64U& left, const V8x64U& right) {
+  V8x64U t(left);
+  return t &= right;
+}
+
+static INLINE V8x64U operator|(const V8x64U& left, const V8x64U& right) {
+  V8x64U t(left);
+  return t |= right;
+}
+
+static INLINE V8x64U operator^(const V8x64U& left, const V8x64U& right) {
+  V8x64U t(left);
+  return t ^= right;
+}
+
+// Load/Store.
+
+// "from" must be vector-aligned.
+static INLINE V8x64U Load(const uint64_t* RESTRICT const from) {
+  return V8x64U(_mm512_load_si512(reinterpret_cast<const __m512i*>(from)));
+}
+
+static INLINE V8x64U LoadU(const uint64_t* RESTRICT const from) {
+  return V8x64U(_mm512_loadu_si512(reinterpret_cast<const __m512i*>(from)));
+}
+
+// Returns the 256-bit vector at "from" (possibly unaligned) in both halves.
+static INLINE V8x64U LoadDup256(const uint64_t* RESTRICT const from) {
+  return V8x64U(_mm512_broadcast_i64x4(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from))));
+}
+
+// "to" must be vector-aligned.
+static INLINE void Store(const V8x64U& v, uint64_t* RESTRICT const to) {
+  _mm512_store_si512(reinterpret_cast<__m512i*>(to), v);
+}
+
+static INLINE void StoreU(const V8x64U& v, uint64_t* RESTRICT const to) {
+  _mm512_storeu_si512(reinterpret_cast<__m512i*>(to), v);
+}
+
+// Writes directly to (aligned) memory, bypassing the cache. This is useful for
+// data that will not be read again in the near future.
+static INLINE void Stream(const V8x64U& v, uint64_t* RESTRICT const to) {
+  _mm512_stream_si512(reinterpret_cast<__m512i*>(to), v);
+}
+
+// Miscellaneous functions.
+
+static INLINE V8x64U AndNot(const V8x64U& neg_mask, const V8x64U& values) {
+  return V8x64U(_mm512_andnot_si512(neg_mask, values));
+}
+
+// Returns the upper and lower 256-bit halves of "v" swapped.
+static INLINE V8x64U SwapHalves(const V8x64U& v) {
+  return V8x64U(_mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// Returns the lower halves of "low" and "high" concatenated.
+static INLINE V8x64U ConcatLowerHalves(const V8x64U& low, const V8x64U& high) {
+  return V8x64U(_mm512_inserti64x4(low, _mm512_castsi512_si256(high), 1));
+}
+
+#endif  // #ifndef HIGHWAYHASH_VEC512_H_